@@ -0,0 +1,787 @@
+#include "model3d.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <locale>
+#include <sstream>
+#include <unordered_map>
+
+
+bool model3dHostIsLittleEndian() {
+    const uint32_t probe = 1;
+    unsigned char first;
+    std::memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+bool model3dIsBinary(const void *data, size_t size) {
+    return size >= sizeof(MODEL3D_MAGIC) && std::memcmp(data, MODEL3D_MAGIC, sizeof(MODEL3D_MAGIC)) == 0;
+}
+
+bool model3dCheckHeader(const Model3DHeader &h, uint64_t fileSize, const std::string &name) {
+    if (!model3dHostIsLittleEndian()) {
+        std::cerr << "Binary .3d files are little-endian only: " << name << std::endl;
+        return false;
+    }
+    if (fileSize < sizeof(Model3DHeader) || !model3dIsBinary(&h, sizeof(h))) {
+        std::cerr << "Not a binary .3d file: " << name << std::endl;
+        return false;
+    }
+    if (h.version == 0 || h.version > MODEL3D_VERSION) {
+        std::cerr << "Unsupported .3d version " << h.version << ": " << name << std::endl;
+        return false;
+    }
+    size_t vertexSize = model3dVertexSize(h.layout);
+    if (vertexSize == 0 || (h.layout == MODEL3D_LAYOUT_POS3S16 && h.version < 3)) {
+        std::cerr << "Unsupported .3d vertex layout " << h.layout << ": " << name << std::endl;
+        return false;
+    }
+    size_t align = h.layout == MODEL3D_LAYOUT_POS3F ? sizeof(float) : sizeof(int16_t);
+    uint64_t bytes = uint64_t(h.vertexCount) * vertexSize;
+    if (h.vertexOffset % align != 0 || h.vertexOffset > fileSize || bytes > fileSize - h.vertexOffset) {
+        std::cerr << "Truncated .3d file: " << name << std::endl;
+        return false;
+    }
+    if (h.version >= 2 && h.indexCount > 0) {
+        if (h.indexSize != 2 && h.indexSize != 4) {
+            std::cerr << "Invalid .3d index size " << h.indexSize << ": " << name << std::endl;
+            return false;
+        }
+        uint64_t indexBytes = uint64_t(h.indexCount) * h.indexSize;
+        if (h.indexOffset % h.indexSize != 0 || h.indexOffset > fileSize || indexBytes > fileSize - h.indexOffset) {
+            std::cerr << "Truncated .3d index data: " << name << std::endl;
+            return false;
+        }
+    }
+    if (h.version >= 5 && !(h.sphereRadius >= 0)) {
+        std::cerr << "Invalid .3d bounding sphere: " << name << std::endl;
+        return false;
+    }
+    if (h.version >= 4 && h.lodCount > 0) {
+        uint64_t lodBytes = uint64_t(h.lodCount) * sizeof(Model3DLod);
+        if (h.indexCount == 0 || h.lodOffset % sizeof(uint32_t) != 0 || h.lodOffset > fileSize
+            || lodBytes > fileSize - h.lodOffset) {
+            std::cerr << "Truncated .3d LOD table: " << name << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool model3dCheckLods(const Model3DHeader &h, const Model3DLod *lods, const std::string &name) {
+    for (uint32_t i = 0; i < h.lodCount; i++) {
+        const Model3DLod &l = lods[i];
+        if (l.indexCount % 3 != 0 || uint64_t(l.firstIndex) + l.indexCount > h.indexCount) {
+            std::cerr << "Invalid .3d LOD " << i << ": " << name << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool model3dParse(const void *data, size_t size, Model3DView &view, const std::string &name) {
+    if (size < sizeof(Model3DHeader) || !model3dIsBinary(data, size)) {
+        std::cerr << "Not a binary .3d file: " << name << std::endl;
+        return false;
+    }
+    const Model3DHeader *h = static_cast<const Model3DHeader *>(data);
+    if (!model3dCheckHeader(*h, size, name)) return false;
+    const char *base = static_cast<const char *>(data);
+    view.header = h;
+    view.vertices = base + h->vertexOffset;
+    view.vertexSize = model3dVertexSize(h->layout);
+    view.vertexBytes = size_t(h->vertexCount) * view.vertexSize;
+    bool indexed = h->version >= 2 && h->indexCount > 0;
+    view.indices = indexed ? base + h->indexOffset : nullptr;
+    view.indexCount = indexed ? h->indexCount : 0;
+    view.indexSize = indexed ? h->indexSize : 0;
+    if (h->version >= 4 && h->lodCount > 0) {
+        view.lods = reinterpret_cast<const Model3DLod *>(base + h->lodOffset);
+        view.lodCount = h->lodCount;
+        if (!model3dCheckLods(*h, view.lods, name)) return false;
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Text .3d parsing
+//-------------------------------------------------------------------------
+
+namespace {
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+// Reference conversion, used for the rare tokens the fast path can't round
+// exactly: the same extraction the old loader did, pinned to the "C" locale.
+template <typename T>
+bool parseSlow(const char *begin, const char *end, T &out) {
+    std::istringstream in(std::string(begin, end));
+    in.imbue(std::locale::classic());
+    in >> out;
+    return !in.fail() && in.peek() == std::char_traits<char>::eof();
+}
+
+// mantissa * 10^exp10 rounded to float (Clinger): with a mantissa of at most
+// 2^53 and a power of ten of at most 10^22 both factors are exact doubles, so
+// the product is correctly rounded to double. Rounding that to float is only
+// wrong when the double lands exactly on a midpoint between two floats.
+// Returns false for those and for arguments outside the exact range.
+bool decimalToFloat(uint64_t mantissa, int exp10, float &out) {
+    static const double kPow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    if (mantissa > (uint64_t(1) << 53) || exp10 < -22 || exp10 > 22) return false;
+    double d = double(mantissa);
+    d = exp10 < 0 ? d / kPow10[-exp10] : d * kPow10[exp10];
+    // d is within the normal float range here, so it sits on a float midpoint
+    // exactly when the 29 mantissa bits float drops read 1000...0.
+    uint64_t bits;
+    std::memcpy(&bits, &d, sizeof(bits));
+    if ((bits & 0x1FFFFFFFull) == 0x10000000ull) return false;
+    out = float(d);
+    return true;
+}
+
+// Parses one float token at p (after whitespace) and advances p past it.
+// Tokens decimalToFloat can't round exactly go to parseSlow.
+bool parseFloat(const char *&p, const char *end, float &out) {
+    const char *start = p;
+    const char *q = p;
+    bool negative = false;
+    if (q < end && (*q == '-' || *q == '+')) negative = (*q++ == '-');
+
+    uint64_t mantissa = 0;
+    int digits = 0, exp10 = 0;
+    bool truncated = false, anyDigit = false;
+    for (; q < end && *q >= '0' && *q <= '9'; ++q) {
+        anyDigit = true;
+        if (digits < 19) { mantissa = mantissa * 10 + uint64_t(*q - '0'); if (mantissa) digits++; }
+        else { exp10++; if (*q != '0') truncated = true; }
+    }
+    if (q < end && *q == '.') {
+        for (++q; q < end && *q >= '0' && *q <= '9'; ++q) {
+            anyDigit = true;
+            if (digits < 19) { mantissa = mantissa * 10 + uint64_t(*q - '0'); if (mantissa) digits++; exp10--; }
+            else if (*q != '0') truncated = true;
+        }
+    }
+    if (anyDigit && q < end && (*q == 'e' || *q == 'E')) {
+        const char *e = q + 1;
+        bool expNegative = false;
+        if (e < end && (*e == '-' || *e == '+')) expNegative = (*e++ == '-');
+        if (e < end && *e >= '0' && *e <= '9') {
+            int value = 0;
+            for (; e < end && *e >= '0' && *e <= '9'; ++e)
+                if (value < 100000) value = value * 10 + (*e - '0');
+            exp10 += expNegative ? -value : value;
+            q = e;
+        }
+    }
+
+    const char *tokenEnd = q;
+    while (tokenEnd < end && !isSpace(*tokenEnd)) ++tokenEnd;
+    p = tokenEnd;
+    if (!anyDigit || q != tokenEnd || truncated)
+        return parseSlow(start, tokenEnd, out);
+
+    if (mantissa == 0) {
+        out = negative ? -0.0f : 0.0f;
+        return true;
+    }
+    float f;
+    if (!decimalToFloat(mantissa, exp10, f))
+        return parseSlow(start, tokenEnd, out);
+    out = negative ? -f : f;
+    return true;
+}
+
+} // namespace
+
+bool model3dParseTextCount(const char *&p, const char *end, size_t &count) {
+    while (p < end && isSpace(*p)) ++p;
+    const char *start = p;
+    while (p < end && !isSpace(*p)) ++p;
+    long long value = 0;
+    if (!parseSlow(start, p, value) || value < 0) return false;
+    count = size_t(value);
+    return true;
+}
+
+size_t model3dParseFloats(const char *&p, const char *end, float *out, size_t maxCount, bool &ok) {
+    ok = true;
+    size_t n = 0;
+    while (n < maxCount) {
+        while (p < end && isSpace(*p)) ++p;
+        if (p == end) break;
+        if (!parseFloat(p, end, out[n])) {
+            ok = false;
+            break;
+        }
+        n++;
+    }
+    return n;
+}
+
+bool model3dParseText(const char *data, size_t size, std::vector<float> &positions, const std::string &name) {
+    const char *p = data;
+    const char *end = data + size;
+    size_t count = 0;
+    if (!model3dParseTextCount(p, end, count)) {
+        std::cerr << "Invalid vertex count in .3d file: " << name << std::endl;
+        return false;
+    }
+    positions.resize(count * 3);
+    bool ok;
+    if (model3dParseFloats(p, end, positions.data(), positions.size(), ok) != positions.size() || !ok) {
+        std::cerr << "Invalid or truncated vertex data in .3d file: " << name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+//-------------------------------------------------------------------------
+// Text .3d writing
+//-------------------------------------------------------------------------
+
+namespace {
+
+const uint64_t kTen[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+    100000000ull, 1000000000ull
+};
+
+// Nearest integer to v * 10^k (the double powers are exact up to 10^22).
+uint64_t scaleToInteger(float v, int k) {
+    static const struct Powers {
+        double p[64];
+        Powers() { for (int i = 0; i < 64; i++) p[i] = std::pow(10.0, i); }
+    } powers;
+    double d = double(v);
+    return uint64_t(std::llround(k >= 0 ? d * powers.p[k] : d / powers.p[-k]));
+}
+
+// True if the reader turns mantissa * 10^exp10 back into exactly v: the
+// fast path when it applies, the reference conversion otherwise.
+bool readsBack(uint64_t mantissa, int exp10, float v) {
+    float back;
+    if (decimalToFloat(mantissa, exp10, back)) return back == v;
+    char token[32];
+    int n = std::snprintf(token, sizeof(token), "%llue%d", (unsigned long long)mantissa, exp10);
+    return parseSlow(token, token + n, back) && back == v;
+}
+
+} // namespace
+
+size_t model3dFormatFloat(float v, char *out) {
+    char *p = out;
+    if (std::signbit(v)) { *p++ = '-'; v = -v; }
+    if (v == 0.0f) { *p++ = '0'; return size_t(p - out); }
+    if (!std::isfinite(v)) {
+        std::memcpy(p, v != v ? "nan" : "inf", 3);
+        return size_t(p - out) + 3;
+    }
+
+    // Nine significant digits always read back as the same float; m9 holds
+    // them, with the leading one at 10^e.
+    int e = int(std::floor(std::log10(double(v))));
+    uint64_t m9 = scaleToInteger(v, 8 - e);
+    while (m9 >= kTen[9]) m9 = scaleToInteger(v, 8 - ++e);
+    while (m9 < kTen[8]) m9 = scaleToInteger(v, 8 - --e);
+
+    // Shortest first: the n-digit neighbours of m9, nearest one first, that
+    // read back as v. Nine digits are the fallback.
+    uint64_t m = m9;
+    int digits = 9, exp = e;
+    for (int n = 1; n < 9 && digits == 9; n++) {
+        uint64_t step = kTen[9 - n];
+        uint64_t below = m9 / step;
+        bool roundUp = m9 % step >= step / 2;
+        for (int k = 0; k < 2; k++) {
+            uint64_t mn = below + ((k == 0) == roundUp ? 1 : 0);
+            int en = e;
+            if (mn == kTen[n]) { mn /= 10; en++; }
+            if (readsBack(mn, en - (n - 1), v)) {
+                m = mn;
+                digits = n;
+                exp = en;
+                break;
+            }
+        }
+    }
+    while (digits > 1 && m % 10 == 0) { m /= 10; digits--; }
+
+    char d[9];
+    for (int i = digits - 1; i >= 0; i--, m /= 10) d[i] = char('0' + m % 10);
+    if (exp >= -4 && exp < 9) {
+        if (exp < 0) {
+            *p++ = '0';
+            *p++ = '.';
+            for (int i = -1; i > exp; i--) *p++ = '0';
+            for (int i = 0; i < digits; i++) *p++ = d[i];
+        } else {
+            for (int i = 0; i <= exp; i++) *p++ = i < digits ? d[i] : '0';
+            if (digits > exp + 1) {
+                *p++ = '.';
+                for (int i = exp + 1; i < digits; i++) *p++ = d[i];
+            }
+        }
+    } else {
+        *p++ = d[0];
+        if (digits > 1) {
+            *p++ = '.';
+            for (int i = 1; i < digits; i++) *p++ = d[i];
+        }
+        *p++ = 'e';
+        *p++ = exp < 0 ? '-' : '+';
+        int a = exp < 0 ? -exp : exp;
+        *p++ = char('0' + a / 10);
+        *p++ = char('0' + a % 10);
+    }
+    return size_t(p - out);
+}
+
+void model3dEncodeText(std::vector<char> &out, const float *positions, size_t count) {
+    std::string header = std::to_string(count) + "\n";
+    out.resize(header.size() + count * 3 * (MODEL3D_FLOAT_CHARS + 1));
+    char *p = out.data();
+    std::memcpy(p, header.data(), header.size());
+    p += header.size();
+    for (size_t i = 0; i < count * 3; i++) {
+        p += model3dFormatFloat(positions[i], p);
+        *p++ = i % 3 == 2 ? '\n' : ' ';
+    }
+    out.resize(size_t(p - out.data()));
+}
+
+void model3dComputeBounds(const float *positions, size_t count, float boundsMin[3], float boundsMax[3]) {
+    for (int k = 0; k < 3; k++) {
+        boundsMin[k] = count ? positions[k] : 0.0f;
+        boundsMax[k] = count ? positions[k] : 0.0f;
+    }
+    for (size_t i = 1; i < count; i++) {
+        const float *p = positions + i * 3;
+        for (int k = 0; k < 3; k++) {
+            if (p[k] < boundsMin[k]) boundsMin[k] = p[k];
+            if (p[k] > boundsMax[k]) boundsMax[k] = p[k];
+        }
+    }
+}
+
+uint64_t model3dHash(const void *data, size_t size, uint64_t seed) {
+    const unsigned char *p = static_cast<const unsigned char *>(data);
+    uint64_t h = seed ^ (uint64_t(size) * 0x9E3779B97F4A7C15ull);
+    auto mix = [&h](uint64_t w) {
+        w *= 0x9E3779B97F4A7C15ull;
+        w ^= w >> 32;
+        h = (h ^ w) * 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 31;
+    };
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        mix(w);
+    }
+    if (i < size) {
+        uint64_t w = 0;
+        std::memcpy(&w, p + i, size - i);
+        mix(w);
+    }
+    return h;
+}
+
+namespace {
+// Hashes/compares a vertex by its exact bit pattern.
+struct VertexKey { uint32_t bits[3]; };
+struct VertexKeyHash {
+    size_t operator()(const VertexKey &k) const {
+        uint64_t h = 1469598103934665603ull;
+        for (int i = 0; i < 3; i++) h = (h ^ k.bits[i]) * 1099511628211ull;
+        return size_t(h ^ (h >> 32));
+    }
+};
+struct VertexKeyEq {
+    bool operator()(const VertexKey &a, const VertexKey &b) const {
+        return a.bits[0] == b.bits[0] && a.bits[1] == b.bits[1] && a.bits[2] == b.bits[2];
+    }
+};
+}
+
+void model3dWeld(const float *soup, size_t count, std::vector<float> &vertices, std::vector<uint32_t> &indices) {
+    std::unordered_map<VertexKey, uint32_t, VertexKeyHash, VertexKeyEq> lookup;
+    lookup.reserve(count / 2);
+    vertices.clear();
+    indices.clear();
+    indices.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        VertexKey key;
+        std::memcpy(key.bits, soup + i * 3, sizeof(key.bits));
+        auto it = lookup.insert(std::make_pair(key, uint32_t(vertices.size() / 3)));
+        if (it.second) vertices.insert(vertices.end(), soup + i * 3, soup + i * 3 + 3);
+        indices.push_back(it.first->second);
+    }
+}
+
+// Header of a plain (not indexed, not quantized unless set up afterwards)
+// file of count vertices; the bounds are left to setHeaderBounds.
+static void initHeader(Model3DHeader &h, uint32_t layout, size_t count) {
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, MODEL3D_MAGIC, sizeof(h.magic));
+    h.version = MODEL3D_VERSION;
+    h.layout = layout;
+    h.vertexCount = uint32_t(count);
+    for (int k = 0; k < 3; k++) {
+        h.quantScale[k] = 1.0f;
+        h.quantOffset[k] = 0.0f;
+    }
+    h.vertexOffset = sizeof(Model3DHeader);
+}
+
+static void setHeaderBounds(Model3DHeader &h, const Model3DBoundingVolume &bv) {
+    std::memcpy(h.boundsMin, bv.boundsMin, sizeof(h.boundsMin));
+    std::memcpy(h.boundsMax, bv.boundsMax, sizeof(h.boundsMax));
+    std::memcpy(h.sphereCenter, bv.center, sizeof(h.sphereCenter));
+    h.sphereRadius = bv.radius;
+}
+
+bool model3dEncode(std::vector<char> &out, const float *positions, size_t count,
+                   const uint32_t *indices, size_t indexCount, uint32_t layout,
+                   const Model3DLod *lods, size_t lodCount) {
+    if (!model3dHostIsLittleEndian()) {
+        std::cerr << "Binary .3d output requires a little-endian host" << std::endl;
+        return false;
+    }
+    if (count > std::numeric_limits<uint32_t>::max() || indexCount > std::numeric_limits<uint32_t>::max()) {
+        std::cerr << "Too many vertices for a .3d file" << std::endl;
+        return false;
+    }
+    if (lodCount > 0 && (!indices || indexCount == 0)) {
+        std::cerr << "A .3d LOD table needs an index list" << std::endl;
+        return false;
+    }
+    size_t vertexSize = model3dVertexSize(layout);
+    if (vertexSize == 0) {
+        std::cerr << "Unknown .3d vertex layout " << layout << std::endl;
+        return false;
+    }
+
+    Model3DHeader h;
+    initHeader(h, layout, count);
+    Model3DBoundingVolume bv;
+    model3dComputeBoundingVolume(positions, count, bv);
+    setHeaderBounds(h, bv);
+    if (layout == MODEL3D_LAYOUT_POS3S16) {
+        // Symmetric range [-32767, 32767] around the box center; a flat axis
+        // keeps scale 1 so the engine's model matrix stays invertible.
+        for (int k = 0; k < 3; k++) {
+            float half = 0.5f * (h.boundsMax[k] - h.boundsMin[k]);
+            h.quantOffset[k] = h.boundsMin[k] + half;
+            if (half > 0.0f) h.quantScale[k] = half / 32767.0f;
+        }
+    }
+    size_t vertexBytes = count * vertexSize;
+    if (indices && indexCount > 0) {
+        h.indexCount = uint32_t(indexCount);
+        h.indexSize = count <= 65536 ? 2 : 4;
+        h.indexOffset = (h.vertexOffset + vertexBytes + h.indexSize - 1) / h.indexSize * h.indexSize;
+    }
+    size_t end = h.indexCount ? size_t(h.indexOffset) + size_t(h.indexCount) * h.indexSize
+                              : size_t(h.vertexOffset) + vertexBytes;
+    if (lodCount > 0) {
+        h.lodCount = uint32_t(lodCount);
+        h.lodOffset = (end + sizeof(uint32_t) - 1) / sizeof(uint32_t) * sizeof(uint32_t);
+        if (!model3dCheckLods(h, lods, "output")) return false;
+        end = size_t(h.lodOffset) + lodCount * sizeof(Model3DLod);
+    }
+
+    out.assign(end, 0);
+    char *dst = out.data();
+    std::memcpy(dst, &h, sizeof(h));
+    if (layout == MODEL3D_LAYOUT_POS3F) {
+        if (vertexBytes) std::memcpy(dst + h.vertexOffset, positions, vertexBytes);
+    } else {
+        int16_t *q = reinterpret_cast<int16_t *>(dst + h.vertexOffset);
+        for (size_t i = 0; i < count * 3; i++) {
+            int k = int(i % 3);
+            long v = std::lround((positions[i] - h.quantOffset[k]) / h.quantScale[k]);
+            q[i] = int16_t(v < -32767 ? -32767 : v > 32767 ? 32767 : v);
+        }
+        // The stored volume must hold what is drawn: the dequantized
+        // positions, which may stray from the box above by a rounding.
+        Model3DView view;
+        view.header = &h;
+        view.vertices = q;
+        model3dComputeBoundingVolume(view, bv);
+        setHeaderBounds(h, bv);
+        std::memcpy(dst, &h, sizeof(h));
+    }
+    if (h.indexSize == 2) {
+        uint16_t *narrow = reinterpret_cast<uint16_t *>(dst + h.indexOffset);
+        for (size_t i = 0; i < indexCount; i++) narrow[i] = uint16_t(indices[i]);
+    } else if (h.indexSize == 4) {
+        std::memcpy(dst + h.indexOffset, indices, indexCount * 4);
+    }
+    if (lodCount > 0) std::memcpy(dst + h.lodOffset, lods, lodCount * sizeof(Model3DLod));
+    return true;
+}
+
+static bool writeImage(const std::string &path, const std::vector<char> &image) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << path << std::endl;
+        return false;
+    }
+    file.write(image.data(), std::streamsize(image.size()));
+    if (!file) {
+        std::cerr << "Error writing file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool model3dWrite(const std::string &path, const float *positions, size_t count,
+                  const uint32_t *indices, size_t indexCount, uint32_t layout,
+                  const Model3DLod *lods, size_t lodCount) {
+    std::vector<char> image;
+    if (!model3dEncode(image, positions, count, indices, indexCount, layout, lods, lodCount)) {
+        std::cerr << "Could not encode " << path << std::endl;
+        return false;
+    }
+    return writeImage(path, image);
+}
+
+bool model3dWriteText(const std::string &path, const float *positions, size_t count) {
+    std::vector<char> image;
+    model3dEncodeText(image, positions, count);
+    return writeImage(path, image);
+}
+
+//-------------------------------------------------------------------------
+// Bounding volumes
+//-------------------------------------------------------------------------
+
+// Grows sphere s (center, radius) to the smallest one holding s and p.
+static void growSphere(double s[4], const float *p) {
+    double d[3], dist2 = 0;
+    for (int k = 0; k < 3; k++) {
+        d[k] = p[k] - s[k];
+        dist2 += d[k] * d[k];
+    }
+    if (dist2 <= s[3] * s[3]) return;
+    double dist = std::sqrt(dist2);
+    double radius = 0.5 * (s[3] + dist);
+    for (int k = 0; k < 3; k++) s[k] += d[k] * (radius - s[3]) / dist;
+    s[3] = radius;
+}
+
+void Model3DBounds::first(const float *p) {
+    if (count_++ == 0) {
+        for (int k = 0; k < 3; k++) {
+            min_[k] = max_[k] = p[k];
+            grown_[k] = p[k];
+        }
+        grown_[3] = 0;
+        for (int e = 0; e < 6; e++) std::memcpy(extreme_[e], p, sizeof(extreme_[e]));
+        return;
+    }
+    for (int k = 0; k < 3; k++) {
+        if (p[k] < min_[k]) { min_[k] = p[k]; std::memcpy(extreme_[k * 2], p, sizeof(extreme_[0])); }
+        if (p[k] > max_[k]) { max_[k] = p[k]; std::memcpy(extreme_[k * 2 + 1], p, sizeof(extreme_[0])); }
+    }
+    growSphere(grown_, p);
+}
+
+void Model3DBounds::second(const float *p) {
+    double dist2 = 0;
+    for (int k = 0; k < 3; k++) {
+        double d = p[k] - 0.5 * (double(min_[k]) + max_[k]);
+        dist2 += d * d;
+    }
+    boxRadius2_ = std::max(boxRadius2_, dist2);
+    growSphere(ritter_, p);
+}
+
+void Model3DBounds::add(const float *positions, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (second_) second(positions + i * 3);
+        else first(positions + i * 3);
+    }
+}
+
+void Model3DBounds::addQuantized(const int16_t *positions, size_t count, const float scale[3],
+                                 const float offset[3]) {
+    float block[3 * 256];
+    for (size_t done = 0; done < count; done += 256) {
+        size_t n = std::min<size_t>(256, count - done);
+        for (size_t i = 0; i < n * 3; i++)
+            block[i] = offset[i % 3] + positions[done * 3 + i] * scale[i % 3];
+        add(block, n);
+    }
+}
+
+void Model3DBounds::secondPass() {
+    second_ = true;
+    boxRadius2_ = 0;
+    // Ritter's seed: the pair of axis extremes furthest apart.
+    double best = -1;
+    for (int k = 0; k < 3 && count_; k++) {
+        const float *a = extreme_[k * 2], *b = extreme_[k * 2 + 1];
+        double dist2 = 0;
+        for (int j = 0; j < 3; j++) dist2 += (double(b[j]) - a[j]) * (double(b[j]) - a[j]);
+        if (dist2 <= best) continue;
+        best = dist2;
+        for (int j = 0; j < 3; j++) ritter_[j] = 0.5 * (double(a[j]) + b[j]);
+        ritter_[3] = 0.5 * std::sqrt(dist2);
+    }
+}
+
+void Model3DBounds::get(Model3DBoundingVolume &bv) const {
+    std::memset(&bv, 0, sizeof(bv));
+    if (count_ == 0) return;
+    double boxCenter[3], boxRadius2 = 0;
+    for (int k = 0; k < 3; k++) {
+        bv.boundsMin[k] = min_[k];
+        bv.boundsMax[k] = max_[k];
+        boxCenter[k] = 0.5 * (double(min_[k]) + max_[k]);
+        double half = 0.5 * (double(max_[k]) - min_[k]);
+        boxRadius2 += half * half;
+    }
+    // Candidates, each holding every vertex: the smallest wins.
+    double box[4] = { boxCenter[0], boxCenter[1], boxCenter[2], std::sqrt(second_ ? boxRadius2_ : boxRadius2) };
+    const double *sphere = box;
+    if (grown_[3] < sphere[3]) sphere = grown_;
+    if (second_ && ritter_[3] < sphere[3]) sphere = ritter_;
+    // Rounding the center to float moves it a little: grow the radius by as
+    // much, and round it up, so the float sphere still holds every vertex.
+    double shift2 = 0;
+    for (int k = 0; k < 3; k++) {
+        bv.center[k] = float(sphere[k]);
+        shift2 += (bv.center[k] - sphere[k]) * (bv.center[k] - sphere[k]);
+    }
+    double radius = sphere[3] + std::sqrt(shift2);
+    bv.radius = float(radius);
+    if (bv.radius < radius) bv.radius = std::nextafter(bv.radius, std::numeric_limits<float>::infinity());
+}
+
+bool model3dHeaderBounds(const Model3DHeader &h, Model3DBoundingVolume &bv) {
+    if (h.version < 5) return false;
+    std::memcpy(bv.boundsMin, h.boundsMin, sizeof(bv.boundsMin));
+    std::memcpy(bv.boundsMax, h.boundsMax, sizeof(bv.boundsMax));
+    std::memcpy(bv.center, h.sphereCenter, sizeof(bv.center));
+    bv.radius = h.sphereRadius;
+    return true;
+}
+
+void model3dComputeBoundingVolume(const float *positions, size_t count, Model3DBoundingVolume &bv) {
+    Model3DBounds bounds;
+    bounds.add(positions, count);
+    bounds.secondPass();
+    bounds.add(positions, count);
+    bounds.get(bv);
+}
+
+void model3dComputeBoundingVolume(const Model3DView &view, Model3DBoundingVolume &bv) {
+    const Model3DHeader &h = *view.header;
+    if (h.layout == MODEL3D_LAYOUT_POS3F) {
+        model3dComputeBoundingVolume(static_cast<const float *>(view.vertices), h.vertexCount, bv);
+        return;
+    }
+    Model3DBounds bounds;
+    const int16_t *q = static_cast<const int16_t *>(view.vertices);
+    bounds.addQuantized(q, h.vertexCount, h.quantScale, h.quantOffset);
+    bounds.secondPass();
+    bounds.addQuantized(q, h.vertexCount, h.quantScale, h.quantOffset);
+    bounds.get(bv);
+}
+
+//-------------------------------------------------------------------------
+// Streamed .3d writing
+//-------------------------------------------------------------------------
+
+bool Model3DStreamWriter::open(const std::string &path, bool text, size_t count) {
+    path_ = path;
+    text_ = text;
+    expected_ = count;
+    written_ = 0;
+    bounds_ = Model3DBounds();
+    if (!text && !model3dHostIsLittleEndian()) {
+        std::cerr << "Binary .3d output requires a little-endian host" << std::endl;
+        return false;
+    }
+    file_.open(path, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!file_.is_open()) {
+        std::cerr << "Error opening file: " << path << std::endl;
+        return false;
+    }
+    if (text) {
+        std::string header = std::to_string(count) + "\n";
+        file_.write(header.data(), std::streamsize(header.size()));
+    } else {
+        // Placeholder until close() knows the bounds.
+        Model3DHeader h;
+        std::memset(&h, 0, sizeof(h));
+        file_.write(reinterpret_cast<const char *>(&h), sizeof(h));
+    }
+    return bool(file_);
+}
+
+bool Model3DStreamWriter::write(const float *positions, size_t count) {
+    if (text_) {
+        buffer_.resize(count * 3 * (MODEL3D_FLOAT_CHARS + 1));
+        char *p = buffer_.data();
+        for (size_t i = 0; i < count * 3; i++) {
+            p += model3dFormatFloat(positions[i], p);
+            *p++ = i % 3 == 2 ? '\n' : ' ';
+        }
+        file_.write(buffer_.data(), std::streamsize(p - buffer_.data()));
+    } else {
+        bounds_.add(positions, count);
+        file_.write(reinterpret_cast<const char *>(positions), std::streamsize(count * 3 * sizeof(float)));
+    }
+    written_ += count;
+    return bool(file_);
+}
+
+bool Model3DStreamWriter::close() {
+    bool ok = bool(file_);
+    if (ok && text_ && written_ != expected_) {
+        std::cerr << "Wrote " << written_ << " of " << expected_ << " vertices: " << path_ << std::endl;
+        ok = false;
+    }
+    if (ok && !text_) {
+        if (written_ > std::numeric_limits<uint32_t>::max()) {
+            std::cerr << "Too many vertices for a .3d file" << std::endl;
+            ok = false;
+        } else {
+            // The tight sphere needs a second look at every vertex: read them
+            // back, a block at a time.
+            bounds_.secondPass();
+            std::vector<float> block(3 * 4096);
+            file_.seekg(sizeof(Model3DHeader));
+            for (size_t done = 0; ok && done < written_; done += 4096) {
+                size_t n = std::min<size_t>(4096, written_ - done);
+                file_.read(reinterpret_cast<char *>(block.data()), std::streamsize(n * 3 * sizeof(float)));
+                ok = bool(file_);
+                if (ok) bounds_.add(block.data(), n);
+            }
+            Model3DHeader h;
+            Model3DBoundingVolume bv;
+            initHeader(h, MODEL3D_LAYOUT_POS3F, written_);
+            bounds_.get(bv);
+            setHeaderBounds(h, bv);
+            file_.seekp(0);
+            file_.write(reinterpret_cast<const char *>(&h), sizeof(h));
+            ok = ok && bool(file_);
+        }
+    }
+    file_.close();
+    if (!ok) std::cerr << "Error writing file: " << path_ << std::endl;
+    return ok;
+}
@@ -0,0 +1,231 @@
+#ifndef MODEL3D_H
+#define MODEL3D_H
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Binary .3d format, shared by the generator (writer) and the engine (reader).
+//
+// The file is a fixed 128-byte header followed by raw little-endian data:
+//
+//   [Model3DHeader][vertex data at header.vertexOffset][index data at header.indexOffset]
+//
+// Index data is optional (indexCount == 0 means a plain triangle list) and is
+// 16-bit when every index fits, 32-bit otherwise (see indexSize).
+//
+// Positions are either plain floats or, since v3, int16 values quantized to the
+// bounding box: position = quantOffset + q * quantScale, per axis.
+//
+// Since v4 a file may hold a chain of levels of detail: a table of Model3DLod
+// at header.lodOffset, each naming a range of the index data. All levels
+// index the one vertex block, finest first.
+//
+// Since v5 the header also holds a bounding sphere, so with the box a reader
+// knows how big a model is without touching its vertices.
+//
+// Legacy text .3d files (vertex count followed by "x y z" lines) are still
+// accepted by the engine; a file is binary iff it starts with MODEL3D_MAGIC.
+// Reserved header fields are written as zero so later versions can claim them.
+
+static const char     MODEL3D_MAGIC[4] = { '3', 'D', 'M', 'B' };
+static const uint32_t MODEL3D_VERSION  = 5;   // 2: index buffer, 3: quantized positions, 4: LODs,
+                                              // 5: bounding sphere
+
+// Vertex layout of the data block.
+enum Model3DLayout : uint32_t {
+    MODEL3D_LAYOUT_POS3F   = 0,   // 3 x float32 per vertex (x, y, z)
+    MODEL3D_LAYOUT_POS3S16 = 1    // v3: 3 x int16 per vertex, see quantScale/quantOffset
+};
+
+// Bytes per vertex of a layout, 0 if the layout is unknown.
+inline size_t model3dVertexSize(uint32_t layout) {
+    return layout == MODEL3D_LAYOUT_POS3F ? 3 * sizeof(float)
+         : layout == MODEL3D_LAYOUT_POS3S16 ? 3 * sizeof(int16_t) : 0;
+}
+
+struct Model3DHeader {
+    char     magic[4];          // MODEL3D_MAGIC
+    uint32_t version;           // MODEL3D_VERSION at write time
+    uint32_t layout;            // Model3DLayout
+    uint32_t vertexCount;
+    float    boundsMin[3];      // axis-aligned bounding box
+    float    boundsMax[3];
+    uint64_t vertexOffset;      // byte offset of the vertex data from the file start
+    uint32_t indexCount;        // v2: number of indices (3 per triangle), 0 if not indexed
+    uint32_t indexSize;         // v2: bytes per index, 2 or 4 (0 if not indexed)
+    uint64_t indexOffset;       // v2: byte offset of the index data from the file start
+    float    quantScale[3];     // v3: dequantization of MODEL3D_LAYOUT_POS3S16 positions
+    float    quantOffset[3];
+    uint32_t lodCount;          // v4: entries of the LOD table, 0 for a single level
+    uint32_t reserved0;
+    uint64_t lodOffset;         // v4: byte offset of the LOD table from the file start
+    float    sphereCenter[3];   // v5: bounding sphere of the (dequantized) positions
+    float    sphereRadius;
+    uint32_t reserved[2];
+};
+static_assert(sizeof(Model3DHeader) == 128, "Model3DHeader must stay 128 bytes");
+
+// One level of detail: triangles indexCount / 3 starting at firstIndex. error
+// is how far the level may stray from the exact surface, in model units, so a
+// reader can project it to pixels and pick the coarsest level that passes.
+struct Model3DLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float    error;
+    uint32_t reserved;
+};
+static_assert(sizeof(Model3DLod) == 16, "Model3DLod must stay 16 bytes");
+
+// Axis-aligned box and bounding sphere of a model, both enclosing every
+// position a reader will draw. All zero for a model without vertices.
+struct Model3DBoundingVolume {
+    float boundsMin[3];
+    float boundsMax[3];
+    float center[3];
+    float radius;
+};
+
+// A validated view over a binary .3d file held in memory (e.g. mmap'ed).
+struct Model3DView {
+    const Model3DHeader *header = nullptr;
+    const void          *vertices = nullptr;    // vertexCount entries of vertexSize bytes
+    size_t               vertexSize = 0;        // model3dVertexSize(header->layout)
+    size_t               vertexBytes = 0;
+    const void          *indices = nullptr;     // indexCount entries of indexSize bytes
+    uint32_t             indexCount = 0;
+    uint32_t             indexSize = 0;
+    const Model3DLod    *lods = nullptr;        // lodCount levels, finest first
+    uint32_t             lodCount = 0;
+};
+
+// True if the host stores integers little-endian (the on-disk byte order).
+bool model3dHostIsLittleEndian();
+
+// True if the buffer starts with the binary magic.
+bool model3dIsBinary(const void *data, size_t size);
+
+// Validates a binary .3d header against the size of its file. Lets a reader
+// that streams the file check it before touching the data.
+bool model3dCheckHeader(const Model3DHeader &h, uint64_t fileSize, const std::string &name);
+
+// Validates a LOD table read from a file whose header passed model3dCheckHeader.
+bool model3dCheckLods(const Model3DHeader &h, const Model3DLod *lods, const std::string &name);
+
+// Validates a binary .3d image and fills the view. Returns false (and prints
+// the reason to stderr) on bad magic, unsupported version/layout or truncation.
+bool model3dParse(const void *data, size_t size, Model3DView &view, const std::string &name);
+
+// Parses a legacy text .3d image (vertex count, then x y z per vertex) into
+// positions. Locale-independent; accepts \n or \r\n line endings and gives
+// the same floats as reading the file with `std::ifstream >> float`.
+bool model3dParseText(const char *data, size_t size, std::vector<float> &positions, const std::string &name);
+
+// Pieces of model3dParseText for readers that stream a text .3d in chunks.
+// model3dParseTextCount reads the leading vertex count. model3dParseFloats
+// parses up to maxCount floats, advancing p. It stops at end, so the caller
+// must not cut a token in half; ok is false after a malformed token.
+bool model3dParseTextCount(const char *&p, const char *end, size_t &count);
+size_t model3dParseFloats(const char *&p, const char *end, float *out, size_t maxCount, bool &ok);
+
+// Longest output of model3dFormatFloat, e.g. "-0.000123456789".
+static const size_t MODEL3D_FLOAT_CHARS = 16;
+
+// Writes the shortest decimal that model3dParseText reads back as exactly v
+// (at most 9 significant digits, "%g"-like layout, no terminator) and
+// returns its length. Locale-independent.
+size_t model3dFormatFloat(float v, char *out);
+
+// Builds a legacy text .3d image of positions (count xyz triples) in memory.
+void model3dEncodeText(std::vector<char> &out, const float *positions, size_t count);
+
+// Computes the axis-aligned bounds of count xyz triples.
+void model3dComputeBounds(const float *positions, size_t count, float boundsMin[3], float boundsMax[3]);
+
+// Builds a Model3DBoundingVolume over vertices fed in any number of blocks.
+// One pass gives the box and a sphere that starts at the first vertex and
+// grows just enough to take in each vertex outside it. An optional second
+// pass over the same vertices (after secondPass()) fits a much tighter
+// sphere: around the box center, or grown again (Ritter) from the widest
+// pair of axis extremes. get() gives the smallest sphere found. The same
+// vertices in the same order always give the same volume.
+class Model3DBounds {
+public:
+    void add(const float *positions, size_t count);
+    void addQuantized(const int16_t *positions, size_t count, const float scale[3], const float offset[3]);
+    void secondPass();
+    void get(Model3DBoundingVolume &bv) const;
+
+private:
+    void first(const float *p);
+    void second(const float *p);
+
+    size_t count_ = 0;
+    bool   second_ = false;
+    float  min_[3], max_[3];
+    float  extreme_[6][3];     // vertices at min_ and max_ of each axis
+    double grown_[4];          // first pass sphere: center, radius
+    double ritter_[4];         // second pass sphere
+    double boxRadius2_ = 0;    // second pass: farthest squared distance from the box center
+};
+
+// Bounding volume stored in a v5+ header; false for older files, whose
+// sphere has to be computed from the vertices (model3dComputeBoundingVolume).
+bool model3dHeaderBounds(const Model3DHeader &h, Model3DBoundingVolume &bv);
+
+// Bounding volume of count xyz triples, or of the vertices of a parsed
+// binary file (any layout), with both passes of Model3DBounds.
+void model3dComputeBoundingVolume(const float *positions, size_t count, Model3DBoundingVolume &bv);
+void model3dComputeBoundingVolume(const Model3DView &view, Model3DBoundingVolume &bv);
+
+// Fast 64-bit content hash (not cryptographic). Chain calls through seed.
+uint64_t model3dHash(const void *data, size_t size, uint64_t seed = 0);
+
+// Collapses bit-identical vertices of a triangle soup (count xyz triples) into
+// unique vertices plus a triangle index list. Vertex order is first use.
+void model3dWeld(const float *soup, size_t count, std::vector<float> &vertices, std::vector<uint32_t> &indices);
+
+// Builds the binary .3d image of positions (count xyz triples) in memory, with
+// an optional index list. The index width is 16-bit when count allows it,
+// 32-bit otherwise. With MODEL3D_LAYOUT_POS3S16 the positions are quantized
+// to 16 bits per axis over the bounding box (half the size, error at most
+// half a step, i.e. extent / 65534 per axis). lods, if given, is a LOD table
+// over the index list.
+bool model3dEncode(std::vector<char> &out, const float *positions, size_t count,
+                   const uint32_t *indices = nullptr, size_t indexCount = 0,
+                   uint32_t layout = MODEL3D_LAYOUT_POS3F,
+                   const Model3DLod *lods = nullptr, size_t lodCount = 0);
+
+// model3dEncode followed by a single write to path.
+bool model3dWrite(const std::string &path, const float *positions, size_t count,
+                  const uint32_t *indices = nullptr, size_t indexCount = 0,
+                  uint32_t layout = MODEL3D_LAYOUT_POS3F,
+                  const Model3DLod *lods = nullptr, size_t lodCount = 0);
+
+// model3dEncodeText followed by a single write to path.
+bool model3dWriteText(const std::string &path, const float *positions, size_t count);
+
+// Writes a triangle list (no index list) to a .3d file as its vertices
+// arrive, so a generator never holds the whole model. A text file needs the
+// vertex count up front; a binary file (MODEL3D_LAYOUT_POS3F) gets its
+// header, with the count and bounds, on close() (which reads the vertices
+// back for the bounding sphere, see Model3DBounds). Either way the bytes match
+// what model3dWriteText / model3dWrite give for the same vertices.
+class Model3DStreamWriter {
+public:
+    bool open(const std::string &path, bool text, size_t count = 0);
+    bool write(const float *positions, size_t count);
+    bool close();   // false (after printing why) if any step failed
+
+private:
+    std::fstream      file_;   // read back for the second bounds pass
+    std::string       path_;
+    bool              text_ = false;
+    size_t            expected_ = 0, written_ = 0;
+    Model3DBounds     bounds_;
+    std::vector<char> buffer_;   // formatted text of one block
+};
+
+#endif // MODEL3D_H
@@ -0,0 +1,38 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Number of worker threads to use when the caller asks for 0 ("automatic").
+inline unsigned resolveThreadCount(unsigned requested) {
+    if (requested > 0) return requested;
+    unsigned hw = std::thread::hardware_concurrency();
+    return hw > 0 ? hw : 1;
+}
+
+// Calls fn(i) for every i in [0, count) on up to `threads` threads (0 = one per
+// core). Items are handed out one at a time, so uneven work balances itself.
+// The calling thread takes part in the work; returns when every item is done.
+template <typename Fn>
+void parallelFor(size_t count, unsigned threads, Fn fn) {
+    unsigned workers = (unsigned)std::min<size_t>(resolveThreadCount(threads), count);
+    if (workers <= 1) {
+        for (size_t i = 0; i < count; i++) fn(i);
+        return;
+    }
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (size_t i = next++; i < count; i = next++) fn(i);
+    };
+    std::vector<std::thread> pool;
+    pool.reserve(workers - 1);
+    for (unsigned t = 1; t < workers; t++) pool.emplace_back(work);
+    work();
+    for (auto &th : pool) th.join();
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,107 @@
+#include "scene_bundle.h"
+#include "model3d.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+bool sceneBundleParse(const void *data, size_t size, SceneBundleView &view, const std::string &name) {
+    if (!model3dHostIsLittleEndian()) {
+        std::cerr << "Scene bundles are little-endian only: " << name << std::endl;
+        return false;
+    }
+    const SceneBundleHeader *h = static_cast<const SceneBundleHeader *>(data);
+    if (size < sizeof(*h) || std::memcmp(h->magic, SCENE_BUNDLE_MAGIC, sizeof(h->magic)) != 0) {
+        std::cerr << "Not a scene bundle: " << name << std::endl;
+        return false;
+    }
+    if (h->version == 0 || h->version > SCENE_BUNDLE_VERSION) {
+        std::cerr << "Unsupported scene bundle version " << h->version << ": " << name << std::endl;
+        return false;
+    }
+    uint64_t tocBytes = uint64_t(h->entryCount) * sizeof(SceneBundleEntry);
+    if (h->tocOffset % 8 != 0 || h->tocOffset > size || tocBytes > size - h->tocOffset || h->namesOffset > size) {
+        std::cerr << "Truncated scene bundle: " << name << std::endl;
+        return false;
+    }
+    const unsigned char *base = static_cast<const unsigned char *>(data);
+    const SceneBundleEntry *entries = reinterpret_cast<const SceneBundleEntry *>(base + h->tocOffset);
+    for (uint32_t i = 0; i < h->entryCount; i++) {
+        const SceneBundleEntry &e = entries[i];
+        if (e.offset > size || e.size > size - e.offset
+            || uint64_t(e.nameOffset) + e.nameLength > size - h->namesOffset) {
+            std::cerr << "Corrupt scene bundle entry " << i << ": " << name << std::endl;
+            return false;
+        }
+    }
+    view.base = base;
+    view.size = size;
+    view.entries = entries;
+    view.entryCount = h->entryCount;
+    view.names = reinterpret_cast<const char *>(base + h->namesOffset);
+    return true;
+}
+
+const SceneBundleEntry *sceneBundleFind(const SceneBundleView &view, const std::string &name, uint32_t type) {
+    for (uint32_t i = 0; i < view.entryCount; i++) {
+        const SceneBundleEntry &e = view.entries[i];
+        if (e.type == type && e.nameLength == name.size()
+            && std::memcmp(view.names + e.nameOffset, name.data(), name.size()) == 0)
+            return &e;
+    }
+    return nullptr;
+}
+
+const SceneBundleEntry *sceneBundleFirst(const SceneBundleView &view, uint32_t type) {
+    for (uint32_t i = 0; i < view.entryCount; i++)
+        if (view.entries[i].type == type) return &view.entries[i];
+    return nullptr;
+}
+
+SceneBundleWriter::SceneBundleWriter() : data_(sizeof(SceneBundleHeader), 0) {}
+
+static void padTo(std::vector<char> &buf, uint64_t align) {
+    buf.resize(size_t((buf.size() + align - 1) / align * align), 0);
+}
+
+void SceneBundleWriter::add(const std::string &name, uint32_t type, const void *data, size_t size) {
+    padTo(data_, SCENE_BUNDLE_ALIGN);
+    SceneBundleEntry e;
+    std::memset(&e, 0, sizeof(e));
+    e.offset = data_.size();
+    e.size = size;
+    e.nameOffset = uint32_t(names_.size());
+    e.nameLength = uint32_t(name.size());
+    e.type = type;
+    entries_.push_back(e);
+    names_ += name;
+    const char *bytes = static_cast<const char *>(data);
+    data_.insert(data_.end(), bytes, bytes + size);
+}
+
+bool SceneBundleWriter::write(const std::string &path) {
+    std::vector<char> &out = data_;   // finished in place: write() is called once
+    padTo(out, SCENE_BUNDLE_ALIGN);
+    SceneBundleHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, SCENE_BUNDLE_MAGIC, sizeof(h.magic));
+    h.version = SCENE_BUNDLE_VERSION;
+    h.entryCount = uint32_t(entries_.size());
+    h.tocOffset = out.size();
+    const char *toc = reinterpret_cast<const char *>(entries_.data());
+    out.insert(out.end(), toc, toc + entries_.size() * sizeof(SceneBundleEntry));
+    h.namesOffset = out.size();
+    out.insert(out.end(), names_.begin(), names_.end());
+    std::memcpy(out.data(), &h, sizeof(h));
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << path << std::endl;
+        return false;
+    }
+    file.write(out.data(), std::streamsize(out.size()));
+    if (!file) {
+        std::cerr << "Error writing file: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,81 @@
+#ifndef SCENE_BUNDLE_H
+#define SCENE_BUNDLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scene bundle (.3db): one XML scene plus every binary .3d it references, in a
+// single file the engine can boot from with one mmap.
+//
+//   [SceneBundleHeader][entry data, each aligned to SCENE_BUNDLE_ALIGN]
+//   [SceneBundleEntry x entryCount][name strings]
+//
+// Entry names are the file names used by the scene's <model file="..."/>.
+
+static const char     SCENE_BUNDLE_MAGIC[4] = { '3', 'D', 'B', 'N' };
+static const uint32_t SCENE_BUNDLE_VERSION  = 1;
+static const uint64_t SCENE_BUNDLE_ALIGN    = 64;
+
+enum SceneBundleEntryType : uint32_t {
+    SCENE_BUNDLE_SCENE = 0,   // XML scene description
+    SCENE_BUNDLE_MODEL = 1    // binary .3d image
+};
+
+struct SceneBundleHeader {
+    char     magic[4];        // SCENE_BUNDLE_MAGIC
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved0;
+    uint64_t tocOffset;       // byte offset of the SceneBundleEntry table
+    uint64_t namesOffset;     // byte offset of the name strings
+};
+static_assert(sizeof(SceneBundleHeader) == 32, "SceneBundleHeader must stay 32 bytes");
+
+struct SceneBundleEntry {
+    uint64_t offset;          // byte offset of the data from the file start
+    uint64_t size;
+    uint32_t nameOffset;      // relative to namesOffset
+    uint32_t nameLength;
+    uint32_t type;            // SceneBundleEntryType
+    uint32_t reserved0;
+};
+static_assert(sizeof(SceneBundleEntry) == 32, "SceneBundleEntry must stay 32 bytes");
+
+// A validated view over a bundle held in memory.
+struct SceneBundleView {
+    const unsigned char    *base = nullptr;
+    size_t                  size = 0;
+    const SceneBundleEntry *entries = nullptr;
+    uint32_t                entryCount = 0;
+    const char             *names = nullptr;
+
+    std::string name(const SceneBundleEntry &e) const { return std::string(names + e.nameOffset, e.nameLength); }
+    const unsigned char *data(const SceneBundleEntry &e) const { return base + e.offset; }
+};
+
+// Validates a bundle image; prints the reason to stderr on failure.
+bool sceneBundleParse(const void *data, size_t size, SceneBundleView &view, const std::string &name);
+
+// First entry with this name and type, or nullptr.
+const SceneBundleEntry *sceneBundleFind(const SceneBundleView &view, const std::string &name, uint32_t type);
+
+// First entry of this type, or nullptr.
+const SceneBundleEntry *sceneBundleFirst(const SceneBundleView &view, uint32_t type);
+
+// Incrementally builds a bundle in memory, then writes it with one call.
+// write() finalizes the image, so it is called once per writer.
+class SceneBundleWriter {
+public:
+    SceneBundleWriter();
+    void add(const std::string &name, uint32_t type, const void *data, size_t size);
+    bool write(const std::string &path);
+
+private:
+    std::vector<char>             data_;
+    std::vector<SceneBundleEntry> entries_;
+    std::string                   names_;
+};
+
+#endif // SCENE_BUNDLE_H
@@ -0,0 +1,81 @@
+// -----------------------------------------------------------------------------
+// Bundler: junta uma cena XML e todos os modelos que ela usa num único
+// ficheiro .3db, de onde o Engine arranca com um só mmap (Engine --bundle).
+// Modelos de texto são convertidos para o formato binário indexado.
+//
+//   Bundler scene.xml out.3db [modelsDir]
+// -----------------------------------------------------------------------------
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+#include "tinyxml2.h"
+#include "mapped_file.h"
+#include "model3d.h"
+#include "scene_bundle.h"
+
+using namespace std;
+using namespace tinyxml2;
+
+static void collectModels(XMLElement* g, set<string>& files) {
+    if (XMLElement* ms = g->FirstChildElement("models"))
+        for (XMLElement* m = ms->FirstChildElement("model"); m; m = m->NextSiblingElement("model"))
+            if (const char* f = m->Attribute("file")) files.insert(f);
+    for (XMLElement* c = g->FirstChildElement("group"); c; c = c->NextSiblingElement("group"))
+        collectModels(c, files);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3 || argc > 4) {
+        cerr << "Usage: Bundler scene.xml out.3db [modelsDir (default ../../models/generated)]" << endl;
+        return 1;
+    }
+    string xmlPath = argv[1];
+    string outPath = argv[2];
+    string modelsDir = argc == 4 ? argv[3] : "../../models/generated";
+
+    MappedFile xml;
+    XMLDocument doc;
+    if (!xml.open(xmlPath) || doc.Parse(reinterpret_cast<const char*>(xml.data()), xml.size()) != XML_SUCCESS) {
+        cerr << "Erro ao ler XML: " << xmlPath << endl;
+        return 1;
+    }
+    XMLElement* w = doc.FirstChildElement("world");
+    if (!w) {
+        cerr << "XML sem <world>: " << xmlPath << endl;
+        return 1;
+    }
+    set<string> files;
+    for (XMLElement* g = w->FirstChildElement("group"); g; g = g->NextSiblingElement("group"))
+        collectModels(g, files);
+
+    SceneBundleWriter bundle;
+    string sceneName = xmlPath.substr(xmlPath.find_last_of("/\\") + 1);
+    bundle.add(sceneName, SCENE_BUNDLE_SCENE, xml.data(), xml.size());
+
+    for (const string& f : files) {
+        string path = modelsDir + "/" + f;
+        MappedFile mf;
+        if (!mf.open(path)) {
+            cerr << "Erro ao abrir modelo: " << path << endl;
+            return 1;
+        }
+        if (model3dIsBinary(mf.data(), mf.size())) {
+            Model3DView view;
+            if (!model3dParse(mf.data(), mf.size(), view, path)) return 1;
+            bundle.add(f, SCENE_BUNDLE_MODEL, mf.data(), mf.size());
+            continue;
+        }
+        vector<float> soup, vertices;
+        vector<uint32_t> indices;
+        vector<char> image;
+        if (!model3dParseText(reinterpret_cast<const char*>(mf.data()), mf.size(), soup, path)) return 1;
+        model3dWeld(soup.data(), soup.size() / 3, vertices, indices);
+        if (!model3dEncode(image, vertices.data(), vertices.size() / 3, indices.data(), indices.size())) return 1;
+        bundle.add(f, SCENE_BUNDLE_MODEL, image.data(), image.size());
+    }
+
+    if (!bundle.write(outPath)) return 1;
+    cout << "Cena " << sceneName << " e " << files.size() << " modelos guardados em " << outPath << endl;
+    return 0;
+}
@@ -4,10 +4,24 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <set>
 #include <cmath>
+#include <memory>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
 #include <GL/glew.h>
 #include <GL/glut.h>
 #include "tinyxml2.h"
+#include "mapped_file.h"
+#include "model3d.h"
+#include "parallel.h"
+#include "mesh_registry.h"
+#include "model_cache.h"
+#include "stream_upload.h"
+#include "scene_bundle.h"
+#include "procedural_model.h"
+#include <sys/stat.h>
 
 using namespace std;
 using namespace tinyxml2;
@@ -25,6 +39,17 @@ using namespace tinyxml2;
 int gWindowWidth = 800;
 int gWindowHeight = 600;
 
+// Diretoria do cache de modelos compilados (--cache-dir); vazio = desligado.
+string gCacheDir;
+
+// Erro máximo, em pixels, de um nível de detalhe para ser escolhido (--lod-pixels).
+float gLodPixels = 1.0f;
+const float kFovY = 45.0f, kNear = 1.0f;
+
+// Modelos a partir deste tamanho são carregados por streaming (--stream-mb).
+size_t gStreamThresholdBytes = size_t(256) << 20;
+const int kStreamChunksPerFrame = 4;
+
 
 // ---------------------------------------------------------------------------
 // Câmara
@@ -93,10 +118,9 @@ struct SingleTransform {
 };
 
 struct ModelData {
-    string fileName;
-    Vec3   localTranslation = { 0,0,0 };
-    GLuint vbo = 0;
-    int    vertexCount = 0;
+    string     fileName;
+    Vec3       localTranslation = { 0,0,0 };
+    MeshHandle mesh = kInvalidMesh;          // buffers GL partilhados (ver meshes)
 };
 
 struct SceneNode {
@@ -105,11 +129,52 @@ struct SceneNode {
     vector<SceneNode>       children;
 };
 
+// Vértices de um modelo carregado: ficheiros binários ficam mapeados em memória
+// e são enviados diretamente para o GPU; ficheiros de texto e modelos
+// procedimentais ficam em owned (e ownedIndices).
+struct ModelSource {
+    unique_ptr<MappedFile> mapping;
+    vector<float>          owned;               // xyz por vértice
+    vector<uint32_t>       ownedIndices;
+    const void*            vertices = nullptr;  // Vec3, ou int16 xyz se quantizado
+    size_t                 vertexCount = 0;
+    VertexFormat           format;
+    const void*            indices = nullptr;   // só em ficheiros binários indexados
+    size_t                 indexCount = 0;
+    size_t                 indexSize = 0;       // 2 ou 4 bytes
+    const Model3DLod*      lods = nullptr;      // níveis de detalhe (só em binários)
+    size_t                 lodCount = 0;
+    Model3DBoundingVolume  bounds = {};
+    uint64_t               contentHash = 0;     // hash dos vértices, índices e níveis
+};
+
+// modelLibrary só guarda os dados do CPU entre o carregamento e o upload;
+// depois disso os modelos vivem apenas no GPU, em meshes.
 struct Scene {
-    vector<SceneNode>         rootNodes;
-    map<string, vector<Vec3>> modelLibrary;
+    vector<SceneNode>          rootNodes;
+    map<string, ModelSource>   modelLibrary;
+    MeshRegistry               meshes;
 } scene;
 
+StreamingUploader gStreamer(scene.meshes);
+
+// Bundle (--bundle): cena e modelos vêm todos de um único ficheiro mapeado.
+MappedFile      gBundleFile;
+SceneBundleView gBundle;
+
+// Lê o XML da cena do ficheiro, ou do bundle se estiver ativo.
+bool loadSceneDocument(XMLDocument& doc, const char* file) {
+    if (gBundle.base) {
+        const SceneBundleEntry* e = sceneBundleFirst(gBundle, SCENE_BUNDLE_SCENE);
+        return e && doc.Parse(reinterpret_cast<const char*>(gBundle.data(*e)), size_t(e->size)) == XML_SUCCESS;
+    }
+    return doc.LoadFile(file) == XML_SUCCESS;
+}
+
+string modelPath(const string& fname) {
+    return "../../models/generated/" + fname;
+}
+
 // -----------------------------------------------------------------------------
 // Funções de apoio a Catmull–Rom e vetores
 // -----------------------------------------------------------------------------
@@ -144,29 +209,273 @@ static void evalCatmullRom(const Vec3& P0, const Vec3& P1,
 }
 
 // -----------------------------------------------------------------------------
-// Carrega modelo .3d (gera VBO)
+// Carrega modelo .3d (binário via mmap, ou texto)
+// -----------------------------------------------------------------------------
+static_assert(sizeof(Vec3) == 3 * sizeof(float), "Vec3 must match the .3d vertex layout");
+
+// Volume envolvente de vértices em owned (texto ou procedimental).
+static void computeBounds(ModelSource& src) {
+    model3dComputeBoundingVolume(src.owned.data(), src.vertexCount, src.bounds);
+}
+
+static bool loadTextModel(const MappedFile& file, const string& path, ModelSource& src) {
+    const char* text = reinterpret_cast<const char*>(file.data());
+    if (!model3dParseText(text, file.size(), src.owned, path)) return false;
+    src.vertices = src.owned.data();
+    src.vertexCount = src.owned.size() / 3;
+    computeBounds(src);
+    return true;
+}
+
+// Aponta src para um .3d binário que já está em memória (mmap do ficheiro ou
+// do bundle); quem chama garante que os dados vivem até ao upload.
+static bool useBinaryModel(const unsigned char* data, size_t size, const string& path, ModelSource& src) {
+    Model3DView view;
+    if (!model3dParse(data, size, view, path)) return false;
+    src.vertices = view.vertices;
+    src.vertexCount = view.header->vertexCount;
+    src.format = vertexFormatOf(*view.header);
+    src.indices = view.indices;
+    src.indexCount = view.indexCount;
+    src.indexSize = view.indexSize;
+    src.lods = view.lods;
+    src.lodCount = view.lodCount;
+    // Ficheiros anteriores à v5 não trazem a esfera: calcula-se uma vez e fica
+    // no cache (se ligado) ao lado dos modelos compilados.
+    if (!model3dHeaderBounds(*view.header, src.bounds)
+        && (gCacheDir.empty() || !modelCacheLoadBounds(gCacheDir, path, src.bounds))) {
+        model3dComputeBoundingVolume(view, src.bounds);
+        if (!gCacheDir.empty()) modelCacheStoreBounds(gCacheDir, path, src.bounds);
+    }
+    // Touch every page here, on the worker, so the upload doesn't stall on I/O.
+    volatile unsigned char sink = 0;
+    for (size_t off = 0; off < size; off += 4096) sink ^= data[off];
+    (void)sink;
+    return true;
+}
+
+static bool useBinaryModel(unique_ptr<MappedFile> mf, const string& path, ModelSource& src) {
+    if (!useBinaryModel(mf->data(), mf->size(), path, src)) return false;
+    src.mapping = std::move(mf);
+    return true;
+}
+
+// Gera em memória um modelo <model primitive=...>.
+static bool loadProceduralModel(const string& name, ModelSource& src) {
+    Mesh mesh;
+    if (!generateProceduralModel(name, mesh, modelPath(""))) return false;
+    src.owned.resize(mesh.vertices.size() * 3);
+    if (!mesh.vertices.empty())
+        memcpy(src.owned.data(), mesh.vertices[0].data(), src.owned.size() * sizeof(float));
+    src.ownedIndices.swap(mesh.indices);
+    src.vertices = src.owned.data();
+    src.vertexCount = mesh.vertices.size();
+    src.indices = src.ownedIndices.data();
+    src.indexCount = src.ownedIndices.size();
+    src.indexSize = sizeof(uint32_t);
+    computeBounds(src);
+    return true;
+}
+
+static void hashModel(ModelSource& src) {
+    src.contentHash = model3dHash(src.vertices, src.vertexCount * src.format.stride);
+    src.contentHash = model3dHash(src.indices, src.indexCount * src.indexSize, src.contentHash);
+    src.contentHash = model3dHash(src.lods, src.lodCount * sizeof(Model3DLod), src.contentHash);
+}
+
+bool loadModelFile(const string& fname, ModelSource& src) {
+    if (isProceduralModel(fname)) {
+        if (!loadProceduralModel(fname, src)) return false;
+        hashModel(src);
+        return true;
+    }
+    if (gBundle.base) {
+        const SceneBundleEntry* e = sceneBundleFind(gBundle, fname, SCENE_BUNDLE_MODEL);
+        if (!e || !useBinaryModel(gBundle.data(*e), size_t(e->size), fname, src)) return false;
+        hashModel(src);
+        return true;
+    }
+    string path = modelPath(fname);
+    unique_ptr<MappedFile> mf(new MappedFile());
+    if (!mf->open(path)) return false;
+    if (model3dIsBinary(mf->data(), mf->size())) {
+        if (!useBinaryModel(std::move(mf), path, src)) return false;
+    }
+    else {
+        // Ficheiro de texto: com cache ligado usa (ou cria) a versão compilada.
+        string cached = gCacheDir.empty() ? string() : modelCachePath(gCacheDir, path);
+        unique_ptr<MappedFile> cf(new MappedFile());
+        if (!cached.empty() && cf->open(cached) && model3dIsBinary(cf->data(), cf->size())) {
+            if (!useBinaryModel(std::move(cf), cached, src)) return false;
+        }
+        else {
+            if (!loadTextModel(*mf, path, src)) return false;
+            mf.reset();
+            if (!cached.empty()) {
+                if (modelCacheStore(cached, src.owned.data(), src.vertexCount)
+                    && cf->open(cached) && model3dIsBinary(cf->data(), cf->size())) {
+                    src = ModelSource();
+                    if (!useBinaryModel(std::move(cf), cached, src)) return false;
+                }
+                else {
+                    cerr << "Aviso: não foi possível guardar " << fname << " no cache" << endl;
+                }
+            }
+        }
+    }
+    hashModel(src);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// Carrega em paralelo todos os modelos distintos da cena
 // -----------------------------------------------------------------------------
-bool loadModelFile(const string& fname) {
-    string path = "../../models/generated/" + fname;
-    ifstream in(path);
-    if (!in) return false;
-    int n; in >> n;
-    vector<Vec3> verts(n);
-    for (int i = 0; i < n; ++i) in >> verts[i].x >> verts[i].y >> verts[i].z;
-    scene.modelLibrary[fname] = verts;
+bool loadModelFiles(const set<string>& files) {
+    vector<string> names(files.begin(), files.end());
+    vector<ModelSource> loaded(names.size());
+    vector<char> ok(names.size(), 0);
+
+    auto t0 = chrono::steady_clock::now();
+    parallelFor(names.size(), 0, [&](size_t i) {
+        ok[i] = loadModelFile(names[i], loaded[i]);
+    });
+    auto ms = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - t0).count();
+
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (!ok[i]) {
+            cerr << "Erro ao carregar modelo: " << names[i] << endl;
+            return false;
+        }
+        scene.modelLibrary[names[i]] = std::move(loaded[i]);
+    }
+    cout << names.size() << " modelos carregados em " << ms << " ms ("
+         << resolveThreadCount(0) << " threads)" << endl;
     return true;
 }
 
+// -----------------------------------------------------------------------------
+// Envia cada modelo distinto para o GPU uma única vez (no thread GL) e
+// liberta a cópia do CPU. Ficheiros com conteúdo idêntico (mesmo com nomes
+// diferentes) partilham o mesmo mesh.
+// -----------------------------------------------------------------------------
+static bool sameContent(const ModelSource& a, const ModelSource& b) {
+    return a.vertexCount == b.vertexCount && a.indexCount == b.indexCount && a.indexSize == b.indexSize
+        && a.format.type == b.format.type
+        && memcmp(a.format.scale, b.format.scale, sizeof(a.format.scale)) == 0
+        && memcmp(a.format.offset, b.format.offset, sizeof(a.format.offset)) == 0
+        && memcmp(a.vertices, b.vertices, a.vertexCount * a.format.stride) == 0
+        && (a.indexCount == 0 || memcmp(a.indices, b.indices, a.indexCount * a.indexSize) == 0)
+        && a.lodCount == b.lodCount
+        && (a.lodCount == 0 || memcmp(a.lods, b.lods, a.lodCount * sizeof(Model3DLod)) == 0);
+}
+
+void uploadModelLibrary() {
+    multimap<uint64_t, pair<const ModelSource*, MeshHandle>> uploaded;
+    size_t duplicates = 0, savedBytes = 0;
+    for (auto& entry : scene.modelLibrary) {
+        const ModelSource& src = entry.second;
+        MeshHandle same = kInvalidMesh;
+        auto range = uploaded.equal_range(src.contentHash);
+        for (auto it = range.first; it != range.second && !same; ++it)
+            if (sameContent(*it->second.first, src)) same = it->second.second;
+        if (same) {
+            scene.meshes.alias(entry.first, same);
+            duplicates++;
+            savedBytes += src.vertexCount * src.format.stride + src.indexCount * src.indexSize;
+            continue;
+        }
+        MeshHandle h = scene.meshes.create(entry.first, src.vertices, src.vertexCount,
+            src.indices, src.indexCount, src.indexSize, src.format);
+        scene.meshes.setLods(h, src.lods, src.lodCount);
+        scene.meshes.setBounds(h, src.bounds);
+        uploaded.insert(make_pair(src.contentHash, make_pair(&src, h)));
+    }
+    cout << scene.meshes.liveCount() << " meshes no GPU; " << duplicates
+         << " ficheiros duplicados partilhados (" << savedBytes << " bytes poupados)" << endl;
+    scene.modelLibrary.clear();
+}
+
+// Liga cada instância de um nó ao mesh partilhado do seu ficheiro
+void bindSceneNode(SceneNode& node) {
+    for (auto& md : node.models)
+        md.mesh = scene.meshes.acquire(scene.meshes.find(md.fileName));
+    for (auto& c : node.children) bindSceneNode(c);
+}
+
+// Desfaz bindSceneNode: cada instância larga a sua referência e os buffers de
+// um mesh são apagados quando a última o larga.
+void releaseSceneNode(SceneNode& node) {
+    for (auto& md : node.models) {
+        scene.meshes.release(md.mesh);
+        md.mesh = kInvalidMesh;
+    }
+    for (auto& c : node.children) releaseSceneNode(c);
+}
+
+// Fecha a cena, com o contexto GL ainda ativo: para os uploads em curso e
+// liberta os meshes de todas as instâncias.
+void teardownScene() {
+    gStreamer.cancel();
+    for (auto& n : scene.rootNodes) releaseSceneNode(n);
+    scene.rootNodes.clear();
+    cout << scene.meshes.liveCount() << " meshes no GPU após fechar a cena" << endl;
+}
+
+// -----------------------------------------------------------------------------
+// Escolhe o nível de detalhe pelo tamanho projetado: o mais grosseiro cujo
+// erro, à distância do ponto mais próximo da esfera envolvente, não passa de
+// gLodPixels no ecrã.
+// -----------------------------------------------------------------------------
+static const Model3DLod* selectLod(const GpuMesh& mesh) {
+    if (mesh.lods.empty()) return nullptr;
+    GLfloat mv[16];
+    glGetFloatv(GL_MODELVIEW_MATRIX, mv);
+    // A escala do modelo (maior coluna da matriz) também escala o erro.
+    float scale = 0;
+    for (int c = 0; c < 3; c++)
+        scale = max(scale, sqrt(mv[c * 4] * mv[c * 4] + mv[c * 4 + 1] * mv[c * 4 + 1] + mv[c * 4 + 2] * mv[c * 4 + 2]));
+    const float* c = mesh.bounds.center;
+    float eye[3];
+    for (int r = 0; r < 3; r++) eye[r] = mv[r] * c[0] + mv[4 + r] * c[1] + mv[8 + r] * c[2] + mv[12 + r];
+    float distance = sqrt(eye[0] * eye[0] + eye[1] * eye[1] + eye[2] * eye[2]) - mesh.bounds.radius * scale;
+    float pixelsPerUnit = gWindowHeight / (2.0f * tanf(kFovY * float(M_PI) / 360.0f) * max(distance, kNear));
+    for (size_t i = mesh.lods.size(); i-- > 1;)
+        if (mesh.lods[i].error * scale * pixelsPerUnit <= gLodPixels) return &mesh.lods[i];
+    return &mesh.lods[0];
+}
+
 // -----------------------------------------------------------------------------
 // Renderiza o modelo (VBO)
 // -----------------------------------------------------------------------------
 void renderModel(const ModelData& M) {
-    if (M.vbo == 0 || M.vertexCount == 0) return;
-    glBindBuffer(GL_ARRAY_BUFFER, M.vbo);
+    const GpuMesh* mesh = scene.meshes.get(M.mesh);
+    if (!mesh || !mesh->ready || mesh->vertexCount == 0) return;
+    const Model3DLod* lod = selectLod(*mesh);
+    // Posições quantizadas: a desquantização vai para a matriz do modelo.
+    const VertexFormat& f = mesh->format;
+    bool quantized = f.type != GL_FLOAT;
+    if (quantized) {
+        glPushMatrix();
+        glTranslatef(f.offset[0], f.offset[1], f.offset[2]);
+        glScalef(f.scale[0], f.scale[1], f.scale[2]);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo);
     glEnableClientState(GL_VERTEX_ARRAY);
-    glVertexPointer(3, GL_FLOAT, sizeof(Vec3), (void*)0);
-    glDrawArrays(GL_TRIANGLES, 0, M.vertexCount);
+    glVertexPointer(3, f.type, f.stride, (void*)0);
+    if (mesh->ibo) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ibo);
+        if (lod) {
+            size_t indexSize = mesh->indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+            glDrawElements(GL_TRIANGLES, GLsizei(lod->indexCount), mesh->indexType,
+                (void*)(size_t(lod->firstIndex) * indexSize));
+        }
+        else glDrawElements(GL_TRIANGLES, mesh->indexCount, mesh->indexType, (void*)0);
+    }
+    else {
+        glDrawArrays(GL_TRIANGLES, 0, mesh->vertexCount);
+    }
     glDisableClientState(GL_VERTEX_ARRAY);
+    if (quantized) glPopMatrix();
 }
 
 // -----------------------------------------------------------------------------
@@ -291,6 +600,9 @@ void drawSceneNode(const SceneNode& N) {
 // Render Scene
 // -----------------------------------------------------------------------------
 void renderScene() {
+    // Modelos grandes continuam a ser enviados para o GPU entre frames.
+    gStreamer.pump(kStreamChunksPerFrame);
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glLoadIdentity();
     gluLookAt(camera.eye[0], camera.eye[1], camera.eye[2],
@@ -310,11 +622,13 @@ void renderScene() {
 // -----------------------------------------------------------------------------
 void changeSize(int w, int h) {
     if (!h) h = 1;
+    gWindowWidth = w;
+    gWindowHeight = h;
     float ratio = (float)w / (float)h;
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
     glViewport(0, 0, w, h);
-    gluPerspective(45.0f, ratio, 1.0f, 1000.0f);
+    gluPerspective(kFovY, ratio, kNear, 1000.0f);
     glMatrixMode(GL_MODELVIEW);
 }
 
@@ -324,7 +638,7 @@ void changeSize(int w, int h) {
 // -----------------------------------------------------------------------------
 // Função recursiva para parse de <group>
 // -----------------------------------------------------------------------------
-bool parseGroup(XMLElement* g, SceneNode& node) {
+bool parseGroup(XMLElement* g, SceneNode& node, set<string>& modelFiles) {
     // parse <transform>
     if (XMLElement* tr = g->FirstChildElement("transform")) {
         for (XMLElement* t = tr->FirstChildElement(); t; t = t->NextSiblingElement()) {
@@ -361,29 +675,22 @@ bool parseGroup(XMLElement* g, SceneNode& node) {
             node.transforms.push_back(st);
         }
     }
-    // parse <models>
+    // parse <models> (os ficheiros só são lidos depois do XML todo percorrido)
     if (XMLElement* ms = g->FirstChildElement("models")) {
         for (XMLElement* m = ms->FirstChildElement("model"); m; m = m->NextSiblingElement("model")) {
             ModelData md;
             const char* f = m->Attribute("file");
-            if (f) {
-                md.fileName = f;
-                if (!scene.modelLibrary.count(md.fileName)) {
-                    if (!loadModelFile(md.fileName)) return false;
-                }
-                auto& verts = scene.modelLibrary[md.fileName];
-                glGenBuffers(1, &md.vbo);
-                glBindBuffer(GL_ARRAY_BUFFER, md.vbo);
-                glBufferData(GL_ARRAY_BUFFER, verts.size() * sizeof(Vec3), verts.data(), GL_STATIC_DRAW);
-                md.vertexCount = (int)verts.size();
-                node.models.push_back(md);
-            }
+            if (f) md.fileName = f;
+            else if (!m->Attribute("primitive")) continue;
+            else if (!proceduralModelName(m, md.fileName)) return false;
+            modelFiles.insert(md.fileName);
+            node.models.push_back(md);
         }
     }
     // parse children
     for (XMLElement* c = g->FirstChildElement("group"); c; c = c->NextSiblingElement("group")) {
         SceneNode child;
-        if (!parseGroup(c, child)) return false;
+        if (!parseGroup(c, child, modelFiles)) return false;
         node.children.push_back(child);
     }
     return true;
@@ -391,15 +698,34 @@ bool parseGroup(XMLElement* g, SceneNode& node) {
 
 bool parseXML(const char* file) {
     XMLDocument doc;
-    if (doc.LoadFile(file) != XML_SUCCESS) return false;
+    if (!loadSceneDocument(doc, file)) return false;
     XMLElement* w = doc.FirstChildElement("world");
     if (!w) return false;
 
+    // 1) percorre o XML e recolhe os ficheiros de modelo distintos
+    set<string> modelFiles;
     for (XMLElement* g = w->FirstChildElement("group");g;g = g->NextSiblingElement("group")) {
         SceneNode rn;
-        if (!parseGroup(g, rn)) return false;
+        if (!parseGroup(g, rn, modelFiles)) return false;
         scene.rootNodes.push_back(rn);
     }
+    // 2) os muito grandes seguem por streaming; os restantes são descodificados em paralelo
+    for (auto it = modelFiles.begin(); it != modelFiles.end();) {
+        struct stat st;
+        string path = modelPath(*it);
+        if (!gBundle.base && stat(path.c_str(), &st) == 0 && size_t(st.st_size) >= gStreamThresholdBytes) {
+            if (!gStreamer.begin(*it, path)) {
+                cerr << "Erro ao carregar modelo: " << *it << endl;
+                return false;
+            }
+            it = modelFiles.erase(it);
+        }
+        else ++it;
+    }
+    if (!loadModelFiles(modelFiles)) return false;
+    // 3) cria os buffers GL, um por modelo distinto, partilhados pelas instâncias
+    uploadModelLibrary();
+    for (auto& rn : scene.rootNodes) bindSceneNode(rn);
     return true;
 }
 
@@ -408,7 +734,7 @@ bool parseXML(const char* file) {
 // ------------------------------------------------------------------
 bool parseWindowAndCamera(const char* file) {
     tinyxml2::XMLDocument doc;
-    if (doc.LoadFile(file) != XML_SUCCESS) return false;
+    if (!loadSceneDocument(doc, file)) return false;
     auto* w = doc.FirstChildElement("world");
     if (!w) return false;
 
@@ -455,7 +781,7 @@ void processKeys(unsigned char key, int x, int y) {
     case 's': camera.rotatePitch(-0.05f); break;
     case 'x': camera.zoom(-0.3f);         break;
     case 'z': camera.zoom(0.3f);         break;
-    case 27: exit(0);                    break;
+    case 27: teardownScene(); exit(0);   break;
     }
     glutPostRedisplay();
 }
@@ -468,6 +794,26 @@ void processKeys(unsigned char key, int x, int y) {
 int main(int argc, char** argv) {
     const char* xmlFile = "../../engine/inputs/test_3_1.xml";
 
+    // Engine [scene.xml] [--cache-dir dir] [--stream-mb n] [--bundle scene.3db] [--lod-pixels p]
+    for (int i = 1; i < argc; ++i) {
+        string a = argv[i];
+        if (a == "--cache-dir" && i + 1 < argc) gCacheDir = argv[++i];
+        else if (a == "--bundle" && i + 1 < argc) {
+            xmlFile = argv[++i];
+            if (!gBundleFile.open(xmlFile) || !sceneBundleParse(gBundleFile.data(), gBundleFile.size(), gBundle, xmlFile)) {
+                cerr << "Erro ao abrir bundle: " << xmlFile << endl;
+                return 1;
+            }
+        }
+        else if (a == "--stream-mb" && i + 1 < argc) gStreamThresholdBytes = size_t(atof(argv[++i]) * (1 << 20));
+        else if (a == "--lod-pixels" && i + 1 < argc) gLodPixels = float(atof(argv[++i]));
+        else if (a[0] != '-') xmlFile = argv[i];
+    }
+    if (!gCacheDir.empty() && !modelCacheInit(gCacheDir)) {
+        cerr << "Aviso: cache de modelos desligado (" << gCacheDir << " inválido)" << endl;
+        gCacheDir.clear();
+    }
+
     if (!parseWindowAndCamera(xmlFile)) {
         std::cerr << "Erro ao ler window/camera do XML\n";
         return 1;
@@ -0,0 +1,112 @@
+#include "mesh_registry.h"
+#include <cassert>
+
+VertexFormat vertexFormatOf(const Model3DHeader& h) {
+    VertexFormat f;
+    if (h.layout == MODEL3D_LAYOUT_POS3S16) {
+        f.type = GL_SHORT;
+        f.stride = GLsizei(model3dVertexSize(h.layout));
+        for (int k = 0; k < 3; k++) {
+            f.scale[k] = h.quantScale[k];
+            f.offset[k] = h.quantOffset[k];
+        }
+    }
+    return f;
+}
+
+MeshHandle MeshRegistry::find(const std::string& name) const {
+    auto it = byName_.find(name);
+    return it == byName_.end() ? kInvalidMesh : it->second;
+}
+
+MeshHandle MeshRegistry::create(const std::string& name, const void* vertices, size_t vertexCount,
+                                const void* indices, size_t indexCount, size_t indexSize,
+                                const VertexFormat& format) {
+    GpuMesh m;
+    m.names.push_back(name);
+    m.format = format;
+    glGenBuffers(1, &m.vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, m.vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * format.stride, vertices, GL_STATIC_DRAW);
+    m.vertexCount = (GLsizei)vertexCount;
+    if (indexCount) {
+        glGenBuffers(1, &m.ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize, indices, GL_STATIC_DRAW);
+        m.indexCount = (GLsizei)indexCount;
+        m.indexType = indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+
+    MeshHandle h;
+    if (!free_.empty()) {
+        h = free_.back();
+        free_.pop_back();
+        meshes_[h - 1] = m;
+    }
+    else {
+        meshes_.push_back(m);
+        h = (MeshHandle)meshes_.size();
+    }
+    byName_[name] = h;
+    return h;
+}
+
+MeshHandle MeshRegistry::createEmpty(const std::string& name, size_t vertexCount,
+                                     size_t indexCount, size_t indexSize, const VertexFormat& format) {
+    MeshHandle h = create(name, nullptr, vertexCount, nullptr, indexCount, indexSize, format);
+    meshes_[h - 1].ready = false;
+    return h;
+}
+
+void MeshRegistry::setReady(MeshHandle h) {
+    if (h == kInvalidMesh || h > meshes_.size()) return;
+    meshes_[h - 1].ready = true;
+}
+
+void MeshRegistry::setLods(MeshHandle h, const Model3DLod* lods, size_t count) {
+    if (h == kInvalidMesh || h > meshes_.size()) return;
+    meshes_[h - 1].lods.assign(lods, lods + count);
+}
+
+void MeshRegistry::setBounds(MeshHandle h, const Model3DBoundingVolume& bounds) {
+    if (h == kInvalidMesh || h > meshes_.size()) return;
+    meshes_[h - 1].bounds = bounds;
+}
+
+void MeshRegistry::alias(const std::string& name, MeshHandle h) {
+    if (h == kInvalidMesh || h > meshes_.size()) return;
+    meshes_[h - 1].names.push_back(name);
+    byName_[name] = h;
+}
+
+// Um slot libertado não tem buffers (como em get); um mesh acabado de criar
+// tem refCount 0 até ao primeiro acquire.
+MeshHandle MeshRegistry::acquire(MeshHandle h) {
+    if (h == kInvalidMesh || h > meshes_.size()) return kInvalidMesh;
+    GpuMesh& m = meshes_[h - 1];
+    assert(m.vbo && "acquire de um mesh já libertado");
+    if (!m.vbo) return kInvalidMesh;
+    m.refCount++;
+    return h;
+}
+
+void MeshRegistry::release(MeshHandle h) {
+    if (h == kInvalidMesh || h > meshes_.size()) return;
+    GpuMesh& m = meshes_[h - 1];
+    // Um release a mais voltaria a pôr h em free_ e dois create() receberiam
+    // o mesmo handle.
+    assert(m.refCount > 0 && "release sem acquire correspondente");
+    if (m.refCount <= 0) return;
+    if (--m.refCount > 0) return;
+    if (m.vbo) glDeleteBuffers(1, &m.vbo);
+    if (m.ibo) glDeleteBuffers(1, &m.ibo);
+    for (auto& n : m.names) byName_.erase(n);
+    m = GpuMesh();
+    free_.push_back(h);
+}
+
+const GpuMesh* MeshRegistry::get(MeshHandle h) const {
+    if (h == kInvalidMesh || h > meshes_.size()) return nullptr;
+    const GpuMesh& m = meshes_[h - 1];
+    return m.vbo ? &m : nullptr;
+}
@@ -0,0 +1,86 @@
+#ifndef MESH_REGISTRY_H
+#define MESH_REGISTRY_H
+
+#include <GL/glew.h>
+#include "model3d.h"
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+// -----------------------------------------------------------------------------
+// Registo de meshes no GPU: um VBO/IBO por asset distinto, partilhado por todas
+// as instâncias que o usam. As instâncias guardam apenas um MeshHandle.
+// -----------------------------------------------------------------------------
+typedef unsigned MeshHandle;           // 0 = inválido
+static const MeshHandle kInvalidMesh = 0;
+
+// Formato dos vértices no VBO. Posições quantizadas (GL_SHORT) são desenhadas
+// com a desquantização (offset + q * scale) aplicada à matriz do modelo.
+struct VertexFormat {
+    GLenum  type = GL_FLOAT;           // GL_FLOAT ou GL_SHORT
+    GLsizei stride = 3 * sizeof(float);
+    float   scale[3] = { 1, 1, 1 };
+    float   offset[3] = { 0, 0, 0 };
+};
+
+// Formato dos vértices de um .3d binário (cabeçalho já validado).
+VertexFormat vertexFormatOf(const Model3DHeader& h);
+
+struct GpuMesh {
+    std::vector<std::string> names;    // nomes de ficheiro que apontam para este mesh
+    GLuint  vbo = 0;
+    GLuint  ibo = 0;                   // 0 => triangle list sem índices
+    GLsizei vertexCount = 0;
+    GLsizei indexCount = 0;
+    GLenum  indexType = GL_UNSIGNED_SHORT;
+    VertexFormat format;
+    std::vector<Model3DLod> lods;      // níveis de detalhe no ibo; vazio = um só nível
+    Model3DBoundingVolume bounds = {}; // caixa e esfera envolventes, no espaço do modelo
+    int     refCount = 0;
+    bool    ready = true;              // false enquanto um upload progressivo decorre
+};
+
+class MeshRegistry {
+public:
+    // Handle do asset com este nome, ou kInvalidMesh se ainda não foi enviado.
+    MeshHandle find(const std::string& name) const;
+
+    // Envia os dados (vértices no formato dado, índices de indexSize bytes) para
+    // o GPU. Os dados do CPU podem ser libertados logo a seguir. Começa sem referências.
+    MeshHandle create(const std::string& name, const void* vertices, size_t vertexCount,
+                      const void* indices, size_t indexCount, size_t indexSize,
+                      const VertexFormat& format = VertexFormat());
+
+    // Reserva buffers com o tamanho final, sem dados, para um upload progressivo
+    // (glBufferSubData). O mesh só é desenhado depois de setReady().
+    MeshHandle createEmpty(const std::string& name, size_t vertexCount, size_t indexCount, size_t indexSize,
+                           const VertexFormat& format = VertexFormat());
+    void setReady(MeshHandle h);
+
+    // Tabela de níveis de detalhe (já validada) de um mesh indexado.
+    void setLods(MeshHandle h, const Model3DLod* lods, size_t count);
+
+    // Volume envolvente do mesh (do cabeçalho do .3d ou calculado ao carregar).
+    void setBounds(MeshHandle h, const Model3DBoundingVolume& bounds);
+
+    // Faz name apontar para um mesh já existente (conteúdo idêntico).
+    void alias(const std::string& name, MeshHandle h);
+
+    // Contagem de referências: cada instância faz acquire; o último release
+    // apaga os buffers GL e liberta o handle.
+    // Um acquire ou release sobre um handle já libertado é ignorado (e falha
+    // um assert nas builds de debug).
+    MeshHandle acquire(MeshHandle h);
+    void release(MeshHandle h);
+
+    const GpuMesh* get(MeshHandle h) const;
+    size_t liveCount() const { return meshes_.size() - free_.size(); }
+
+private:
+    std::vector<GpuMesh>              meshes_;   // handle h vive em meshes_[h-1]
+    std::vector<MeshHandle>           free_;
+    std::map<std::string, MeshHandle> byName_;
+};
+
+#endif // MESH_REGISTRY_H
@@ -0,0 +1,94 @@
+#include "model_cache.h"
+#include "model3d.h"
+#include <cstdio>
+#include <functional>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/types.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+bool modelCacheInit(const std::string& cacheDir) {
+    struct stat st;
+    if (stat(cacheDir.c_str(), &st) == 0) return (st.st_mode & S_IFDIR) != 0;
+#ifdef _WIN32
+    return _mkdir(cacheDir.c_str()) == 0;
+#else
+    return mkdir(cacheDir.c_str(), 0755) == 0;
+#endif
+}
+
+std::string modelCachePath(const std::string& cacheDir, const std::string& sourcePath) {
+    struct stat st;
+    if (stat(sourcePath.c_str(), &st) != 0) return "";
+    std::ostringstream key;
+    key << sourcePath << '|' << (long long)st.st_size << '|' << (long long)st.st_mtime << '|' << MODEL3D_VERSION;
+    std::string k = key.str();
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.3d", (unsigned long long)model3dHash(k.data(), k.size()));
+    return cacheDir + "/" + name;
+}
+
+// A temporary file of this thread for a cache entry.
+static std::string tempPath(const std::string& cachePath) {
+    std::ostringstream tmp;
+    tmp << cachePath << ".tmp" << std::hash<std::thread::id>()(std::this_thread::get_id());
+    return tmp.str();
+}
+
+// Moves a finished temporary file into place.
+static bool publish(const std::string& tmp, const std::string& cachePath) {
+    if (std::rename(tmp.c_str(), cachePath.c_str()) != 0) {
+        // Another process may have stored the same entry first.
+        std::remove(tmp.c_str());
+        struct stat st;
+        return stat(cachePath.c_str(), &st) == 0;
+    }
+    return true;
+}
+
+bool modelCacheStore(const std::string& cachePath, const float* soup, size_t count) {
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+    model3dWeld(soup, count, vertices, indices);
+
+    std::string tmp = tempPath(cachePath);
+    if (!model3dWrite(tmp, vertices.data(), vertices.size() / 3, indices.data(), indices.size())) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return publish(tmp, cachePath);
+}
+
+static std::string boundsPath(const std::string& cacheDir, const std::string& sourcePath) {
+    std::string path = modelCachePath(cacheDir, sourcePath);
+    return path.empty() ? path : path.substr(0, path.size() - 3) + ".bounds";
+}
+
+bool modelCacheLoadBounds(const std::string& cacheDir, const std::string& sourcePath, Model3DBoundingVolume& bv) {
+    std::string path = boundsPath(cacheDir, sourcePath);
+    FILE* f = path.empty() ? nullptr : fopen(path.c_str(), "rb");
+    if (!f) return false;
+    bool ok = fread(&bv, sizeof(bv), 1, f) == 1;
+    fclose(f);
+    return ok;
+}
+
+bool modelCacheStoreBounds(const std::string& cacheDir, const std::string& sourcePath,
+                           const Model3DBoundingVolume& bv) {
+    std::string path = boundsPath(cacheDir, sourcePath);
+    if (path.empty()) return false;
+    std::string tmp = tempPath(path);
+    FILE* f = fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = fwrite(&bv, sizeof(bv), 1, f) == 1;
+    ok = fclose(f) == 0 && ok;
+    if (!ok) {
+        std::remove(tmp.c_str());
+        return false;
+    }
+    return publish(tmp, path);
+}
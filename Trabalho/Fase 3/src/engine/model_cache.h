@@ -0,0 +1,32 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include <cstddef>
+#include <string>
+#include "model3d.h"
+
+// -----------------------------------------------------------------------------
+// Cache em disco (opcional, --cache-dir) de modelos de texto compilados para o
+// formato binário indexado. Arranques seguintes fazem só mmap da versão compilada.
+// -----------------------------------------------------------------------------
+
+// Cria a diretoria do cache se ainda não existir.
+bool modelCacheInit(const std::string& cacheDir);
+
+// Caminho da versão compilada de sourcePath dentro de cacheDir. A chave junta
+// caminho, tamanho e mtime da fonte e a versão do formato, por isso qualquer
+// alteração dá uma entrada nova. Devolve "" se a fonte não existir.
+std::string modelCachePath(const std::string& cacheDir, const std::string& sourcePath);
+
+// Solda o triangle list (count vértices xyz) e grava-o em cachePath, indexado
+// e com bounds. Escreve para um temporário e renomeia, para que outro processo
+// nunca leia um ficheiro a meio.
+bool modelCacheStore(const std::string& cachePath, const float* soup, size_t count);
+
+// Volume envolvente de um .3d binário anterior à v5 (sem esfera no cabeçalho),
+// calculado uma vez e guardado no cache com a mesma chave que modelCachePath.
+bool modelCacheLoadBounds(const std::string& cacheDir, const std::string& sourcePath, Model3DBoundingVolume& bv);
+bool modelCacheStoreBounds(const std::string& cacheDir, const std::string& sourcePath,
+                           const Model3DBoundingVolume& bv);
+
+#endif // MODEL_CACHE_H
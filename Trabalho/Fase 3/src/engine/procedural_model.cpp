@@ -0,0 +1,100 @@
+#include "procedural_model.h"
+#include "bezier.h"
+#include "model3d.h"
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+struct PrimitiveParams {
+    const char* primitive;
+    const char* params[4];   // atributos, nullptr no fim
+};
+
+const PrimitiveParams kPrimitives[] = {
+    { "plane",  { "dimension", "divisions" } },
+    { "sphere", { "radius", "slices", "stacks" } },
+    { "box",    { "dimension", "divisions" } },
+    { "cone",   { "bottomRadius", "height", "slices", "stacks" } },
+    { "ring",   { "outerRadius", "innerRadius", "slices" } },
+    { "icosphere",  { "radius", "subdivisions" } },
+    { "cubesphere", { "radius", "divisions" } },
+};
+
+// Escreve v na forma decimal mais curta que lhe corresponde, para que "1" e
+// "1.0" deem o mesmo nome.
+std::string canonical(float v) {
+    char buf[MODEL3D_FLOAT_CHARS];
+    return std::string(buf, model3dFormatFloat(v, buf));
+}
+
+} // namespace
+
+bool proceduralModelName(const tinyxml2::XMLElement* m, std::string& name) {
+    std::string primitive = m->Attribute("primitive");
+    std::ostringstream out;
+    out << '@' << primitive;
+    if (primitive == "patch") {
+        const char* file = m->Attribute("patch");
+        int tessellation = 0;
+        if (!file || m->QueryIntAttribute("tessellation", &tessellation) != tinyxml2::XML_SUCCESS) {
+            std::cerr << "Modelo patch precisa de patch e tessellation" << std::endl;
+            return false;
+        }
+        out << ' ' << tessellation << ' ' << canonical(m->FloatAttribute("tolerance")) << ' ' << file;
+        name = out.str();
+        return true;
+    }
+    for (const PrimitiveParams& p : kPrimitives) {
+        if (primitive != p.primitive) continue;
+        for (const char* attr : p.params) {
+            if (!attr) break;
+            float v;
+            if (m->QueryFloatAttribute(attr, &v) != tinyxml2::XML_SUCCESS) {
+                std::cerr << "Modelo " << primitive << " sem o atributo " << attr << std::endl;
+                return false;
+            }
+            out << ' ' << canonical(v);
+        }
+        name = out.str();
+        return true;
+    }
+    std::cerr << "Primitiva desconhecida: " << primitive << std::endl;
+    return false;
+}
+
+bool isProceduralModel(const std::string& name) {
+    return !name.empty() && name[0] == '@';
+}
+
+// Caminhos absolutos: "/...", "\\..." ou com letra de unidade ("C:...").
+static bool isAbsolutePath(const std::string& path) {
+    return !path.empty() && (path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':'));
+}
+
+bool generateProceduralModel(const std::string& name, Mesh& mesh, const std::string& modelDir) {
+    std::istringstream in(name.substr(1));
+    std::string primitive;
+    in >> primitive;
+    if (primitive == "patch") {
+        int tessellation;
+        float tolerance;
+        std::string file;
+        in >> tessellation >> tolerance >> std::ws;
+        std::getline(in, file);
+        if (!isAbsolutePath(file)) file = modelDir + file;
+        try {
+            // Os modelos já são gerados em paralelo, por isso cada patch usa um só thread.
+            mesh = bezier(file, tessellation, 1, tolerance);
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return false;
+        }
+        return true;
+    }
+    std::vector<float> params;
+    for (float v; in >> v;) params.push_back(v);
+    return generatePrimitive(primitive, params, mesh);
+}
@@ -0,0 +1,33 @@
+#ifndef PROCEDURAL_MODEL_H
+#define PROCEDURAL_MODEL_H
+
+#include <string>
+#include "tinyxml2.h"
+#include "primitives.h"
+
+// -----------------------------------------------------------------------------
+// Modelos procedimentais: <model primitive="sphere" radius="1" slices="32"
+// stacks="32"/> é gerado em memória no carregamento, com as funções do gerador
+// (biblioteca Primitives), sem passar por models/generated.
+// -----------------------------------------------------------------------------
+
+// Nome canónico do modelo descrito por m (ex. "@sphere 1 32 32"), usado como
+// chave da biblioteca de modelos: parâmetros iguais dão o mesmo nome e o mesmo
+// mesh. Devolve false (e diz porquê) se a primitiva ou os parâmetros faltarem.
+// Atributos, pela ordem do gerador:
+//   plane: dimension divisions          sphere: radius slices stacks
+//   box: dimension divisions            cone: bottomRadius height slices stacks
+//   ring: outerRadius innerRadius slices
+//   patch: patch (ficheiro .patch) tessellation [tolerance]
+// O ficheiro .patch é relativo à pasta dos modelos, a mesma dos atributos
+// file (models/generated), ou um caminho absoluto: patch="../../generator/teapot.patch".
+bool proceduralModelName(const tinyxml2::XMLElement* m, std::string& name);
+
+// True para nomes criados por proceduralModelName.
+bool isProceduralModel(const std::string& name);
+
+// Gera o mesh de um nome criado por proceduralModelName; os ficheiros .patch
+// relativos são procurados em modelDir (a pasta dos modelos, terminada em '/').
+bool generateProceduralModel(const std::string& name, Mesh& mesh, const std::string& modelDir);
+
+#endif // PROCEDURAL_MODEL_H
@@ -0,0 +1,227 @@
+#include "stream_upload.h"
+#include "model3d.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+// 64-bit file positioning, so multi-GB meshes can be streamed.
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#define ftell64 _ftelli64
+#else
+#define fseek64 fseeko
+#define ftell64 ftello
+#endif
+
+const size_t StreamingUploader::kChunkBytes;
+
+StreamingUploader::~StreamingUploader() {
+    cancel();
+}
+
+void StreamingUploader::cancel() {
+    for (auto& j : jobs_)
+        if (j.file) fclose(j.file);
+    jobs_.clear();
+    std::vector<char>().swap(chunk_);
+    std::vector<float>().swap(floats_);
+}
+
+bool StreamingUploader::begin(const std::string& name, const std::string& path) {
+    Job job;
+    job.name = name;
+    job.path = path;
+    job.file = fopen(path.c_str(), "rb");
+    if (!job.file) return false;
+    int64_t size = fseek64(job.file, 0, SEEK_END) == 0 ? int64_t(ftell64(job.file)) : -1;
+    if (size < 0 || fseek64(job.file, 0, SEEK_SET) != 0) {
+        std::cerr << "Cannot read the size of: " << path << std::endl;
+        fclose(job.file);
+        return false;
+    }
+    uint64_t fileSize = uint64_t(size);
+
+    Model3DHeader h;
+    size_t got = fread(&h, 1, sizeof(h), job.file);
+    size_t vertexCount = 0, indexCount = 0, indexSize = 0;
+    VertexFormat format;
+    if (model3dIsBinary(&h, got)) {
+        if (got < sizeof(h) || !model3dCheckHeader(h, fileSize, path)) { fclose(job.file); return false; }
+        vertexCount = h.vertexCount;
+        format = vertexFormatOf(h);
+        job.vertexOffset = h.vertexOffset;
+        job.vertexBytes = uint64_t(vertexCount) * format.stride;
+        if (h.version >= 2 && h.indexCount > 0) {
+            indexCount = h.indexCount;
+            indexSize = h.indexSize;
+            job.indexOffset = h.indexOffset;
+            job.indexBytes = uint64_t(indexCount) * indexSize;
+        }
+    }
+    else {
+        // Texto: só a contagem inicial é lida aqui; os floats vêm bloco a bloco.
+        const char* p = reinterpret_cast<const char*>(&h);
+        const char* end = p + got;
+        if (!model3dParseTextCount(p, end, vertexCount) || p == end) {
+            std::cerr << "Invalid vertex count in .3d file: " << path << std::endl;
+            fclose(job.file);
+            return false;
+        }
+        job.text = true;
+        job.floatsTotal = vertexCount * 3;
+        if (fseek64(job.file, int64_t(p - reinterpret_cast<const char*>(&h)), SEEK_SET) != 0) {
+            fclose(job.file);
+            return false;
+        }
+    }
+    std::vector<Model3DLod> lods;
+    if (!job.text && h.version >= 4 && h.lodCount > 0) {
+        lods.resize(h.lodCount);
+        if (fseek64(job.file, int64_t(h.lodOffset), SEEK_SET) != 0
+            || fread(lods.data(), sizeof(Model3DLod), lods.size(), job.file) != lods.size()
+            || !model3dCheckLods(h, lods.data(), path)) {
+            fclose(job.file);
+            return false;
+        }
+    }
+    job.mesh = meshes_.createEmpty(name, vertexCount, indexCount, indexSize, format);
+    meshes_.setLods(job.mesh, lods.data(), lods.size());
+    Model3DBoundingVolume bounds;
+    if (!job.text && model3dHeaderBounds(h, bounds)) meshes_.setBounds(job.mesh, bounds);
+    else job.computeBounds = true;
+    job.format = format;
+    jobs_.push_back(job);
+    return true;
+}
+
+bool StreamingUploader::pump(int maxChunks) {
+    while (maxChunks-- > 0 && !jobs_.empty()) {
+        Job& job = jobs_.front();
+        bool more = job.text ? stepText(job) : step(job);
+        if (!more) jobs_.pop_front();
+    }
+    if (jobs_.empty()) {
+        // Nothing left to stream: give the chunk memory back.
+        std::vector<char>().swap(chunk_);
+        std::vector<float>().swap(floats_);
+    }
+    return !jobs_.empty();
+}
+
+// Copia o próximo bloco de um ficheiro binário. Devolve false quando o job acaba.
+bool StreamingUploader::step(Job& job) {
+    const GpuMesh* mesh = meshes_.get(job.mesh);
+    uint64_t offset = job.inIndices ? job.indexOffset : job.vertexOffset;
+    uint64_t total = job.inIndices ? job.indexBytes : job.vertexBytes;
+    // Blocos de vértices com vértices inteiros (12 é múltiplo dos dois strides).
+    size_t chunk = job.inIndices ? kChunkBytes : kChunkBytes - kChunkBytes % 12;
+    size_t n = size_t(std::min<uint64_t>(chunk, total - job.done));
+    if (n > 0) {
+        chunk_.resize(kChunkBytes);
+        if (fseek64(job.file, int64_t(offset + job.done), SEEK_SET) != 0 || fread(chunk_.data(), 1, n, job.file) != n) {
+            std::cerr << "Erro ao ler " << job.path << std::endl;
+            finish(job, false);
+            return false;
+        }
+        GLenum target = job.inIndices ? GL_ELEMENT_ARRAY_BUFFER : GL_ARRAY_BUFFER;
+        glBindBuffer(target, job.inIndices ? mesh->ibo : mesh->vbo);
+        glBufferSubData(target, GLintptr(job.done), GLsizeiptr(n), chunk_.data());
+        job.done += n;
+        if (job.computeBounds && !job.inIndices) {
+            size_t count = n / job.format.stride;
+            if (job.format.type == GL_FLOAT)
+                job.bounds.add(reinterpret_cast<const float*>(chunk_.data()), count);
+            else
+                job.bounds.addQuantized(reinterpret_cast<const int16_t*>(chunk_.data()), count,
+                    job.format.scale, job.format.offset);
+        }
+    }
+    if (job.done < total) return true;
+    if (!job.inIndices && job.indexBytes > 0) {
+        job.inIndices = true;
+        job.done = 0;
+        return true;
+    }
+    finish(job, true);
+    return false;
+}
+
+// Lê um bloco de texto, converte os tokens completos e envia os floats.
+bool StreamingUploader::stepText(Job& job) {
+    chunk_.resize(kChunkBytes);
+    size_t got = fread(chunk_.data() + job.pending, 1, kChunkBytes - job.pending, job.file);
+    size_t size = job.pending + got;
+    bool eof = got < kChunkBytes - job.pending;
+
+    // Sem EOF, o último token pode continuar no próximo bloco: pára antes dele.
+    size_t cut = size;
+    if (!eof) {
+        while (cut > 0 && !strchr(" \t\r\n\v\f", chunk_[cut - 1])) cut--;
+        if (cut == 0) {
+            std::cerr << "Token demasiado longo em " << job.path << std::endl;
+            finish(job, false);
+            return false;
+        }
+    }
+
+    floats_.resize(kChunkBytes / 2 + 1);
+    const char* p = chunk_.data();
+    const char* end = p + cut;
+    bool ok;
+    size_t room = std::min(floats_.size(), job.floatsTotal - job.floatsDone);
+    size_t n = model3dParseFloats(p, end, floats_.data(), room, ok);
+    if (!ok) {
+        std::cerr << "Invalid or truncated vertex data in .3d file: " << job.path << std::endl;
+        finish(job, false);
+        return false;
+    }
+    if (n > 0) {
+        glBindBuffer(GL_ARRAY_BUFFER, meshes_.get(job.mesh)->vbo);
+        glBufferSubData(GL_ARRAY_BUFFER, GLintptr(job.floatsDone * sizeof(float)),
+            GLsizeiptr(n * sizeof(float)), floats_.data());
+        job.floatsDone += n;
+        addBounds(job, floats_.data(), n);
+    }
+    if (job.floatsDone == job.floatsTotal) {
+        finish(job, true);
+        return false;
+    }
+    if (eof) {
+        std::cerr << "Invalid or truncated vertex data in .3d file: " << job.path << std::endl;
+        finish(job, false);
+        return false;
+    }
+    job.pending = size - size_t(p - chunk_.data());
+    memmove(chunk_.data(), p, job.pending);
+    return true;
+}
+
+// Junta ao volume de um ficheiro de texto os vértices completos de um bloco;
+// um vértice cortado fica em partial até ao bloco seguinte.
+void StreamingUploader::addBounds(Job& job, const float* floats, size_t count) {
+    size_t i = 0;
+    while (job.partialCount > 0 && i < count) {
+        job.partial[job.partialCount++] = floats[i++];
+        if (job.partialCount == 3) {
+            job.bounds.add(job.partial, 1);
+            job.partialCount = 0;
+        }
+    }
+    size_t whole = (count - i) / 3;
+    job.bounds.add(floats + i, whole);
+    for (i += whole * 3; i < count; i++) job.partial[job.partialCount++] = floats[i];
+}
+
+void StreamingUploader::finish(Job& job, bool ok) {
+    fclose(job.file);
+    job.file = nullptr;
+    if (ok && job.computeBounds) {
+        Model3DBoundingVolume bounds;
+        job.bounds.get(bounds);
+        meshes_.setBounds(job.mesh, bounds);
+    }
+    if (ok) {
+        meshes_.setReady(job.mesh);
+        std::cout << "Modelo " << job.name << " carregado (streaming)" << std::endl;
+    }
+}
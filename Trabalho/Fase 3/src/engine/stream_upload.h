@@ -0,0 +1,70 @@
+#ifndef STREAM_UPLOAD_H
+#define STREAM_UPLOAD_H
+
+#include "mesh_registry.h"
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+
+// -----------------------------------------------------------------------------
+// Upload progressivo de modelos muito grandes. O ficheiro é lido em blocos de
+// tamanho fixo e cada bloco vai para o buffer GL (já com o tamanho final) com
+// glBufferSubData, por isso a memória do CPU fica limitada a um bloco, seja
+// qual for o tamanho do mesh. Os uploads avançam um pouco em cada frame e
+// cada mesh passa a ser desenhado assim que fica completo.
+// -----------------------------------------------------------------------------
+class StreamingUploader {
+public:
+    static const size_t kChunkBytes = 4u << 20;
+
+    explicit StreamingUploader(MeshRegistry& meshes) : meshes_(meshes) {}
+    ~StreamingUploader();
+
+    // Lê o cabeçalho de path, reserva o mesh name no registo e põe-no em fila.
+    bool begin(const std::string& name, const std::string& path);
+
+    // Processa no máximo maxChunks blocos (no thread GL). Devolve true
+    // enquanto houver uploads por terminar.
+    bool pump(int maxChunks);
+
+    bool busy() const { return !jobs_.empty(); }
+
+    // Abandona os uploads por terminar (os meshes reservados ficam por desenhar).
+    void cancel();
+
+private:
+    struct Job {
+        std::string name, path;
+        MeshHandle  mesh = kInvalidMesh;
+        FILE*       file = nullptr;
+        bool        text = false;
+        // binário: região de vértices e depois região de índices
+        uint64_t    vertexOffset = 0, vertexBytes = 0;
+        uint64_t    indexOffset = 0, indexBytes = 0;
+        uint64_t    done = 0;               // bytes já enviados da região atual
+        bool        inIndices = false;
+        // texto: floats já enviados e bytes de um token cortado no fim do bloco
+        size_t      floatsTotal = 0, floatsDone = 0;
+        size_t      pending = 0;
+        // ficheiros sem esfera no cabeçalho: volume calculado bloco a bloco
+        bool        computeBounds = false;
+        Model3DBounds bounds;
+        VertexFormat format;
+        float       partial[3];             // vértice de texto cortado entre blocos
+        size_t      partialCount = 0;
+    };
+
+    void addBounds(Job& job, const float* floats, size_t count);
+
+    bool step(Job& job);
+    bool stepText(Job& job);
+    void finish(Job& job, bool ok);
+
+    MeshRegistry&     meshes_;
+    std::deque<Job>   jobs_;
+    std::vector<char> chunk_;               // bloco lido do ficheiro
+    std::vector<float> floats_;             // floats de um bloco de texto
+};
+
+#endif // STREAM_UPLOAD_H
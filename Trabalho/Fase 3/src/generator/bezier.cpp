@@ -1,10 +1,18 @@
 #include "bezier.h"
+#include "parallel.h"
 #include <fstream>
 #include <sstream>
 #include <stdexcept>
 #include <vector>
 #include <string>
 #include <array>
+#include <chrono>
+#include <ostream>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <cstdint>
+#include <memory>
 
 // Helper struct for control points
 struct Vec3 { float x, y, z; };
@@ -20,7 +28,164 @@ static float bernstein3(int i, float t) {
     }
 }
 
-std::vector<Vertex> bezier(const std::string &patchFile, int tessellation) {
+// Bernstein weights of one tessellation level, shared by every patch. One
+// array per basis function, so the grid loops below read contiguous floats.
+struct BezierBasis {
+    int n;
+    std::vector<float> w[4];   // w[k][i] = B_k^3(i / n)
+
+    explicit BezierBasis(int n) : n(n) {
+        for (int k = 0; k < 4; ++k) {
+            w[k].resize(n + 1);
+            for (int i = 0; i <= n; ++i) w[k][i] = bernstein3(k, float(i)/n);
+        }
+    }
+};
+
+// Evaluates the (nu+1)x(nv+1) grid of one patch into gx/gy/gz (row iu, column iv).
+// Each row first folds its u weights into the control points (B(u) * P),
+// which leaves four points; every column is then a 4-term dot product with
+// the v weights, written per axis as a plain loop the compiler vectorizes.
+static void evaluatePatch(const std::array<std::array<Vec3,4>,4> &P, const BezierBasis &bu,
+                          const BezierBasis &bv, float *gx, float *gy, float *gz) {
+    int nu = bu.n, nv = bv.n;
+    const float *b0 = bv.w[0].data(), *b1 = bv.w[1].data();
+    const float *b2 = bv.w[2].data(), *b3 = bv.w[3].data();
+    for (int iu = 0; iu <= nu; ++iu) {
+        Vec3 r[4];
+        for (int jj = 0; jj < 4; ++jj) {
+            r[jj] = {0, 0, 0};
+            for (int ii = 0; ii < 4; ++ii) {
+                float b = bu.w[ii][iu];
+                r[jj].x += b*P[ii][jj].x;
+                r[jj].y += b*P[ii][jj].y;
+                r[jj].z += b*P[ii][jj].z;
+            }
+        }
+        float *x = gx + iu*(nv+1), *y = gy + iu*(nv+1), *z = gz + iu*(nv+1);
+        for (int iv = 0; iv <= nv; ++iv)
+            x[iv] = r[0].x*b0[iv] + r[1].x*b1[iv] + r[2].x*b2[iv] + r[3].x*b3[iv];
+        for (int iv = 0; iv <= nv; ++iv)
+            y[iv] = r[0].y*b0[iv] + r[1].y*b1[iv] + r[2].y*b2[iv] + r[3].y*b3[iv];
+        for (int iv = 0; iv <= nv; ++iv)
+            z[iv] = r[0].z*b0[iv] + r[1].z*b1[iv] + r[2].z*b2[iv] + r[3].z*b3[iv];
+    }
+}
+
+// The per-point evaluation evaluatePatch replaced: both weight sets at every
+// grid point and the 16-term double sum. Kept as the reference for
+// benchmarkBezier.
+static void evaluatePatchDirect(const std::array<std::array<Vec3,4>,4> &P, int nu, int nv,
+                                float *gx, float *gy, float *gz) {
+    for (int iu = 0; iu <= nu; ++iu) {
+        float u = float(iu)/nu;
+        float Bu[4]; for (int ii = 0; ii < 4; ++ii) Bu[ii] = bernstein3(ii, u);
+        for (int iv = 0; iv <= nv; ++iv) {
+            float v = float(iv)/nv;
+            float Bv[4]; for (int jj = 0; jj < 4; ++jj) Bv[jj] = bernstein3(jj, v);
+            Vec3 sum{0,0,0};
+            for (int ii = 0; ii < 4; ++ii)
+                for (int jj = 0; jj < 4; ++jj) {
+                    float b = Bu[ii]*Bv[jj];
+                    sum.x += b*P[ii][jj].x;
+                    sum.y += b*P[ii][jj].y;
+                    sum.z += b*P[ii][jj].z;
+                }
+            int g = iu*(nv+1)+iv;
+            gx[g] = sum.x; gy[g] = sum.y; gz[g] = sum.z;
+        }
+    }
+}
+
+// Largest second difference of the control polygon along u (dir 0, across
+// rows) or v (dir 1, across columns).
+static float secondDifference(const std::array<std::array<Vec3,4>,4> &P, int dir) {
+    float worst = 0;
+    for (int a = 0; a < 4; ++a)
+        for (int b = 0; b < 2; ++b) {
+            const Vec3 &p0 = dir == 0 ? P[b][a] : P[a][b];
+            const Vec3 &p1 = dir == 0 ? P[b+1][a] : P[a][b+1];
+            const Vec3 &p2 = dir == 0 ? P[b+2][a] : P[a][b+2];
+            float dx = p0.x - 2*p1.x + p2.x, dy = p0.y - 2*p1.y + p2.y, dz = p0.z - 2*p1.z + p2.z;
+            worst = std::max(worst, std::sqrt(dx*dx + dy*dy + dz*dz));
+        }
+    return worst;
+}
+
+// Segments a direction needs to keep its chords within tolerance. A cubic
+// strays from its n-segment polyline by at most 3/4 * |second difference| / n^2;
+// each direction gets half the tolerance.
+static int levelFor(float secondDiff, float tolerance, int maxLevel) {
+    float n = std::ceil(std::sqrt(0.75f * secondDiff / (0.5f * tolerance)));
+    return n < 1 ? 1 : n > maxLevel ? maxLevel : int(n);
+}
+
+static int findRoot(std::vector<int> &parent, int a) {
+    while (parent[a] != a) a = parent[a] = parent[parent[a]];
+    return a;
+}
+
+// Control-point indices along one side of a patch, in the direction of its
+// parameter: sides 0/1 run along u at v = 0/1, sides 2/3 along v at u = 0/1.
+static std::array<int,4> sideIndices(const std::array<int,16> &patch, int side) {
+    std::array<int,4> s;
+    for (int k = 0; k < 4; ++k)
+        s[k] = side < 2 ? patch[k*4 + (side == 0 ? 0 : 3)] : patch[(side == 2 ? 0 : 3)*4 + k];
+    return s;
+}
+
+static bool collapsed(const std::array<int,4> &s) {
+    return s[0] == s[1] && s[1] == s[2] && s[2] == s[3];
+}
+
+// Orientation-free key of a patch side; reversed tells whether the patch
+// runs it backwards.
+static std::array<int,4> edgeKey(const std::array<int,4> &s, bool &reversed) {
+    std::array<int,4> r = {{s[3], s[2], s[1], s[0]}};
+    reversed = r < s;
+    return reversed ? r : s;
+}
+
+// Per-patch segment counts, u in [2p] and v in [2p+1]. A patch edge has as
+// many segments as the direction it runs along, so directions joined by a
+// shared edge (same four control-point indices, either orientation) are
+// merged and all take the finest level any of them needs. Every shared edge
+// is then split the same way on both sides and the mesh has no cracks.
+static std::vector<int> adaptiveLevels(const std::vector<std::array<int,16>> &patches,
+                                       const std::vector<Vec3> &controlPoints,
+                                       float tolerance, int maxLevel) {
+    std::vector<int> parent(patches.size() * 2);
+    for (size_t i = 0; i < parent.size(); ++i) parent[i] = int(i);
+    std::map<std::array<int,4>, int> edgeOwner;
+    for (size_t p = 0; p < patches.size(); ++p)
+        for (int side = 0; side < 4; ++side) {
+            std::array<int,4> s = sideIndices(patches[p], side);
+            if (collapsed(s)) continue;
+            bool reversed;
+            int node = int(p) * 2 + (side < 2 ? 0 : 1);
+            auto it = edgeOwner.insert(std::make_pair(edgeKey(s, reversed), node)).first;
+            parent[findRoot(parent, node)] = findRoot(parent, it->second);
+        }
+
+    std::vector<int> level(parent.size(), 1);
+    for (size_t p = 0; p < patches.size(); ++p) {
+        std::array<std::array<Vec3,4>,4> P;
+        for (int i = 0; i < 4; ++i)
+            for (int j = 0; j < 4; ++j)
+                P[i][j] = controlPoints[ patches[p][i*4 + j] ];
+        for (int dir = 0; dir < 2; ++dir) {
+            int &root = level[findRoot(parent, int(p) * 2 + dir)];
+            root = std::max(root, levelFor(secondDifference(P, dir), tolerance, maxLevel));
+        }
+    }
+    for (size_t i = 0; i < level.size(); ++i) level[i] = level[findRoot(parent, int(i))];
+    return level;
+}
+
+// Reads a .patch file: the patch count, one line of 16 control-point
+// indices per patch, the control-point count and one "x, y, z" line each.
+static void readPatches(const std::string &patchFile, std::vector<std::array<int,16>> &patches,
+                        std::vector<Vec3> &controlPoints) {
     std::ifstream in(patchFile);
     if (!in)
         throw std::runtime_error("Cannot open patch file: " + patchFile);
@@ -32,7 +197,6 @@ std::vector<Vertex> bezier(const std::string &patchFile, int tessellation) {
     int numPatches = std::stoi(line);
 
     // Read patch index lists
-    std::vector<std::array<int,16>> patches;
     patches.reserve(numPatches);
     for (int p = 0; p < numPatches; ++p) {
         if (!std::getline(in, line))
@@ -54,7 +218,6 @@ std::vector<Vertex> bezier(const std::string &patchFile, int tessellation) {
     int numPoints = std::stoi(line);
 
     // Read control points
-    std::vector<Vec3> controlPoints;
     controlPoints.reserve(numPoints);
     for (int i = 0; i < numPoints; ++i) {
         if (!std::getline(in, line))
@@ -69,58 +232,216 @@ std::vector<Vertex> bezier(const std::string &patchFile, int tessellation) {
         }
         controlPoints.push_back({v[0], v[1], v[2]});
     }
+}
+
+// The 4x4 grid of control points of a patch.
+static std::array<std::array<Vec3,4>,4> patchPoints(const std::array<int,16> &patch,
+                                                   const std::vector<Vec3> &controlPoints) {
+    std::array<std::array<Vec3,4>,4> P;
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            P[i][j] = controlPoints[ patch[i*4 + j] ];
+    return P;
+}
+
+Mesh bezier(const std::string &patchFile, int tessellation, unsigned threads, float tolerance, float *maxError) {
+    if (tessellation < 1)
+        throw std::runtime_error("Invalid tessellation level: " + std::to_string(tessellation));
+    std::vector<std::array<int,16>> patches;
+    std::vector<Vec3> controlPoints;
+    readPatches(patchFile, patches, controlPoints);
+
+    // Segments per patch along u and v: the uniform level, or the adaptive
+    // choice capped at it.
+    std::vector<int> level;
+    if (tolerance > 0)
+        level = adaptiveLevels(patches, controlPoints, tolerance, tessellation);
+    else
+        level.assign(patches.size() * 2, tessellation);
+    if (maxError) {
+        // The chord bound levelFor inverts, summed over both directions.
+        *maxError = 0;
+        for (size_t p = 0; p < patches.size(); ++p) {
+            std::array<std::array<Vec3,4>,4> P = patchPoints(patches[p], controlPoints);
+            float e = 0;
+            for (int dir = 0; dir < 2; ++dir) {
+                float n = float(level[2*p + dir]);
+                e += 0.75f * secondDifference(P, dir) / (n * n);
+            }
+            *maxError = std::max(*maxError, e);
+        }
+    }
+
+    std::vector<std::unique_ptr<BezierBasis>> bases(tessellation + 1);
+    for (int n : level)
+        if (!bases[n]) bases[n].reset(new BezierBasis(n));
+
+    // Vertices on patch boundaries are shared and numbered first, in patch
+    // order: corners by control-point index, edge points by edge and
+    // parameter. An edge's points are evaluated once from its own four
+    // control points, so both patches along it use the very same vertices.
+    // A side whose four control points are one point (a pole) is that corner.
+    const uint32_t none = UINT32_MAX;
+    struct Side { uint32_t first; bool reversed, pole; };   // pole: first is its corner
+    std::vector<uint32_t> corner(controlPoints.size(), none);
+    std::map<std::array<int,4>, uint32_t> edgeFirst;
+    std::vector<std::array<Side,4>> sides(patches.size());
+    Mesh mesh;
+    auto cornerVertex = [&](int cp) {
+        if (corner[cp] == none) {
+            corner[cp] = uint32_t(mesh.vertices.size());
+            const Vec3 &c = controlPoints[cp];
+            mesh.vertices.push_back({c.x, c.y, c.z});
+        }
+        return corner[cp];
+    };
+    for (size_t p = 0; p < patches.size(); ++p) {
+        const std::array<int,16> &patch = patches[p];
+        for (int c : {0, 3, 12, 15}) cornerVertex(patch[c]);
+        for (int side = 0; side < 4; ++side) {
+            std::array<int,4> s = sideIndices(patch, side);
+            Side &out = sides[p][side];
+            out.pole = collapsed(s);
+            out.reversed = false;
+            if (out.pole) {
+                out.first = cornerVertex(s[0]);
+                continue;
+            }
+            std::array<int,4> key = edgeKey(s, out.reversed);
+            auto it = edgeFirst.find(key);
+            if (it != edgeFirst.end()) { out.first = it->second; continue; }
+            out.first = uint32_t(mesh.vertices.size());
+            edgeFirst.insert(std::make_pair(key, out.first));
+            const BezierBasis &b = *bases[level[2*p + (side < 2 ? 0 : 1)]];
+            for (int k = 1; k < b.n; ++k) {
+                Vec3 sum{0,0,0};
+                for (int i = 0; i < 4; ++i) {
+                    const Vec3 &c = controlPoints[key[i]];
+                    sum.x += b.w[i][k]*c.x;
+                    sum.y += b.w[i][k]*c.y;
+                    sum.z += b.w[i][k]*c.z;
+                }
+                mesh.vertices.push_back({sum.x, sum.y, sum.z});
+            }
+        }
+    }
 
-    std::vector<Vertex> outVerts;
-    outVerts.reserve((tessellation*tessellation*2) * 3 * numPatches);
+    // Interior vertices and triangles go to per-patch slices, so the output
+    // doesn't depend on how patches are spread over the threads.
+    std::vector<size_t> interior(patches.size() + 1), firstIndex(patches.size() + 1);
+    interior[0] = mesh.vertices.size();
+    firstIndex[0] = 0;
+    for (size_t p = 0; p < patches.size(); ++p) {
+        int nu = level[2*p], nv = level[2*p + 1];
+        interior[p + 1] = interior[p] + size_t(nu - 1) * (nv - 1);
+        firstIndex[p + 1] = firstIndex[p] + size_t(nu) * nv * 6;
+    }
+    mesh.vertices.resize(interior.back());
+    mesh.indices.resize(firstIndex.back());
+    std::vector<size_t> indexCount(patches.size());
 
     // Tessellate each patch
-    for (auto &patch : patches) {
+    parallelFor(patches.size(), threads, [&](size_t p) {
+        const std::array<int,16> &patch = patches[p];
         // Build the 4x4 grid of control points for this patch
-        std::array<std::array<Vec3,4>,4> P;
-        for (int i = 0; i < 4; ++i)
-            for (int j = 0; j < 4; ++j)
-                P[i][j] = controlPoints[ patch[i*4 + j] ];
+        std::array<std::array<Vec3,4>,4> P = patchPoints(patch, controlPoints);
 
         // Evaluate grid points
-        int n = tessellation;
-        std::vector<Vec3> grid((n+1)*(n+1));
-        for (int iu = 0; iu <= n; ++iu) {
-            float u = float(iu)/n;
-            float Bu[4]; for (int ii = 0; ii < 4; ++ii) Bu[ii] = bernstein3(ii, u);
-            for (int iv = 0; iv <= n; ++iv) {
-                float v = float(iv)/n;
-                float Bv[4]; for (int jj = 0; jj < 4; ++jj) Bv[jj] = bernstein3(jj, v);
-                Vec3 sum{0,0,0};
-                for (int ii = 0; ii < 4; ++ii)
-                    for (int jj = 0; jj < 4; ++jj) {
-                        float b = Bu[ii]*Bv[jj];
-                        sum.x += b*P[ii][jj].x;
-                        sum.y += b*P[ii][jj].y;
-                        sum.z += b*P[ii][jj].z;
-                    }
-                grid[iu*(n+1)+iv] = sum;
+        int nu = level[2*p], nv = level[2*p + 1];
+        std::vector<float> grid(3*(nu+1)*(nv+1));
+        float *gx = grid.data(), *gy = gx + (nu+1)*(nv+1), *gz = gy + (nu+1)*(nv+1);
+        evaluatePatch(P, *bases[nu], *bases[nv], gx, gy, gz);
+        for (int i = 1; i < nu; ++i)
+            for (int j = 1; j < nv; ++j) {
+                int g = i*(nv+1)+j;
+                mesh.vertices[interior[p] + (i-1)*(nv-1) + (j-1)] = {gx[g], gy[g], gz[g]};
             }
-        }
-        
-        // Create triangles
-        for (int i = 0; i < n; ++i) {
-            for (int j = 0; j < n; ++j) {
-                int idx = i*(n+1)+j;
-                auto &v00 = grid[idx];
-                auto &v10 = grid[idx+1];
-                auto &v01 = grid[idx+(n+1)];
-                auto &v11 = grid[idx+(n+1)+1];
-                // Triangle 1
-                outVerts.push_back({v00.x, v00.y, v00.z});
-                outVerts.push_back({v10.x, v10.y, v10.z});
-                outVerts.push_back({v01.x, v01.y, v01.z});
-                // Triangle 2
-                outVerts.push_back({v10.x, v10.y, v10.z});
-                outVerts.push_back({v11.x, v11.y, v11.z});
-                outVerts.push_back({v01.x, v01.y, v01.z});
+
+        // Mesh vertex of grid point (i, j)
+        auto vertexAt = [&](int i, int j) -> uint32_t {
+            if (i > 0 && i < nu && j > 0 && j < nv)
+                return uint32_t(interior[p] + (i-1)*(nv-1) + (j-1));
+            if ((i == 0 || i == nu) && (j == 0 || j == nv))
+                return corner[patch[(i ? 12 : 0) + (j ? 3 : 0)]];
+            int side = j == 0 ? 0 : j == nv ? 1 : i == 0 ? 2 : 3;
+            int k = side < 2 ? i : j, n = side < 2 ? nu : nv;
+            const Side &s = sides[p][side];
+            if (s.pole) return s.first;
+            return s.first + uint32_t((s.reversed ? n - k : k) - 1);
+        };
+
+        // Create triangles, dropping the ones a pole collapses
+        uint32_t *out = &mesh.indices[firstIndex[p]], *start = out;
+        auto emit = [&](uint32_t a, uint32_t b, uint32_t c) {
+            if (a == b || b == c || a == c) return;
+            *out++ = a; *out++ = b; *out++ = c;
+        };
+        for (int i = 0; i < nu; ++i) {
+            for (int j = 0; j < nv; ++j) {
+                uint32_t v00 = vertexAt(i, j), v10 = vertexAt(i, j+1);
+                uint32_t v01 = vertexAt(i+1, j), v11 = vertexAt(i+1, j+1);
+                emit(v00, v10, v01);   // Triangle 1
+                emit(v10, v11, v01);   // Triangle 2
             }
         }
+        indexCount[p] = size_t(out - start);
+    });
+
+    // Close the gaps the dropped triangles left between the slices
+    size_t used = 0;
+    for (size_t p = 0; p < patches.size(); ++p) {
+        std::copy(mesh.indices.begin() + firstIndex[p], mesh.indices.begin() + firstIndex[p] + indexCount[p],
+                  mesh.indices.begin() + used);
+        used += indexCount[p];
+    }
+    mesh.indices.resize(used);
+    return mesh;
+}
+
+void benchmarkBezier(const std::string &patchFile, int tessellation, std::ostream &out) {
+    if (tessellation < 1)
+        throw std::runtime_error("Invalid tessellation level: " + std::to_string(tessellation));
+    std::vector<std::array<int,16>> patches;
+    std::vector<Vec3> controlPoints;
+    readPatches(patchFile, patches, controlPoints);
+    if (patches.empty())
+        throw std::runtime_error("No patches in: " + patchFile);
+    std::vector<std::array<std::array<Vec3,4>,4>> points;
+    for (const std::array<int,16> &patch : patches) points.push_back(patchPoints(patch, controlPoints));
+
+    // Enough rounds over the file for about 2^24 grid points per method.
+    int n = tessellation;
+    size_t size = size_t(n+1)*(n+1);
+    size_t rounds = std::max<size_t>(1, (size_t(1) << 24) / (size * patches.size()));
+    std::vector<float> direct(3*size), basisGrid(3*size);
+    float *dx = direct.data(), *dy = dx + size, *dz = dy + size;
+    float *bx = basisGrid.data(), *by = bx + size, *bz = by + size;
+
+    // Same inputs, one thread; each method is timed in full, basis setup included.
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point t0 = Clock::now();
+    for (size_t r = 0; r < rounds; ++r)
+        for (const auto &P : points) evaluatePatchDirect(P, n, n, dx, dy, dz);
+    Clock::time_point t1 = Clock::now();
+    for (size_t r = 0; r < rounds; ++r) {
+        BezierBasis basis(n);
+        for (const auto &P : points) evaluatePatch(P, basis, basis, bx, by, bz);
+    }
+    Clock::time_point t2 = Clock::now();
+    // The largest difference between the two, over every patch.
+    BezierBasis basis(n);
+    float difference = 0;
+    for (const auto &P : points) {
+        evaluatePatchDirect(P, n, n, dx, dy, dz);
+        evaluatePatch(P, basis, basis, bx, by, bz);
+        for (size_t g = 0; g < 3*size; ++g) difference = std::max(difference, std::fabs(direct[g] - basisGrid[g]));
     }
 
-    return outVerts;
+    double before = std::chrono::duration<double, std::milli>(t1 - t0).count();
+    double after = std::chrono::duration<double, std::milli>(t2 - t1).count();
+    double evaluated = double(rounds) * patches.size() * size;
+    out << patches.size() << " patches, tessellation " << n << ", " << rounds << " rounds, one thread\n"
+        << "  per-point Bernstein sums: " << before << " ms (" << before * 1e6 / evaluated << " ns/point)\n"
+        << "  precomputed weights:      " << after << " ms (" << after * 1e6 / evaluated << " ns/point)\n"
+        << "  speedup " << before / after << "x, largest difference " << difference << std::endl;
 }
@@ -1,12 +1,34 @@
 #pragma once
 #include <vector>
 #include <string>
-#include "primitives.h"  // for Vertex typedef
+#include <ostream>
+#include "primitives.h"  // for Mesh
 
 /// Tessellates a 4×4 Bézier patch defined by controlPointFile (16 rows of x y z),
-/// at the given tessellation level, and returns a list of triangles.
+/// at the given tessellation level, and returns an indexed triangle mesh.
+/// Patches are tessellated on `threads` worker threads (0 = one per core);
+/// the result is the same for any thread count.
+/// With a tolerance > 0 each patch picks its own levels along u and v, at most
+/// `tessellation`, so that no chord strays further than tolerance from the
+/// surface; patches that share an edge split it the same way (no cracks).
+/// Corners and edge points shared by neighbouring patches (same control-point
+/// indices) are emitted once, so the mesh is welded and watertight.
+/// maxError, if given, receives a bound on how far the mesh strays from the
+/// surface (the worst patch).
+/// Throws std::runtime_error for an unreadable patch file or a tessellation
+/// below 1.
   
-std::vector<Vertex> bezier(
+Mesh bezier(
     const std::string &controlPointFile,
-    int tessellation);
+    int tessellation,
+    unsigned threads = 0,
+    float tolerance = 0,
+    float *maxError = nullptr);
+
+/// Times the grid evaluation of every patch of controlPointFile at the given
+/// tessellation level on one thread: the per-point Bernstein sums bezier()
+/// used to do against the precomputed weights it uses now. Writes both
+/// times, the speedup and the largest difference between the two to out.
+/// Throws like bezier().
+void benchmarkBezier(const std::string &controlPointFile, int tessellation, std::ostream &out);
     
\ No newline at end of file
@@ -1,63 +1,330 @@
+#include <algorithm>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 #include <string>
 #include <vector>
+#include <sys/stat.h>
 #include "primitives.h"
 #include "bezier.h"
+#include "simplify.h"
+#include "parallel.h"
+
+// Settings given as "--" options.
+struct Options {
+    ModelFormat format = ModelFormat::Binary;
+    unsigned threads = 0;
+    float tolerance = 0;
+    float maxError = 0;
+    int lods = 1;
+    bool optimize = false;
+    bool stream = false;
+    bool force = false;
+};
+
+// Options start with "--" and may appear anywhere; everything else is
+// positional and goes to args. Returns false if an option's value is not a
+// number or is out of range.
+static bool parseArguments(const std::vector<std::string> &words, Options &opt, std::vector<std::string> &args) {
+    for (size_t i = 0; i < words.size(); i++) {
+        const std::string &a = words[i];
+        try {
+            if (a == "--text") opt.format = ModelFormat::Text;
+            else if (a == "--quantize") opt.format = ModelFormat::Quantized;
+            else if (a == "--threads" && i + 1 < words.size()) opt.threads = unsigned(std::stoul(words[++i]));
+            else if (a == "--tolerance" && i + 1 < words.size()) opt.tolerance = std::stof(words[++i]);
+            else if (a == "--max-error" && i + 1 < words.size()) opt.maxError = std::stof(words[++i]);
+            else if (a == "--lod" && i + 1 < words.size()) opt.lods = std::max(1, std::stoi(words[++i]));
+            else if (a == "--optimize") opt.optimize = true;
+            else if (a == "--stream") opt.stream = true;
+            else if (a == "--force") opt.force = true;
+            else args.push_back(a);
+        } catch (const std::invalid_argument &) {
+            return false;
+        } catch (const std::out_of_range &) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void printUsage() {
+    std::cerr << "Usage:\n"
+              << "  plane: generator plane dimension divisions outputfile\n"
+              << "  sphere: generator sphere radius slices stacks outputfile\n"
+              << "  box: generator box dimension divisions outputfile\n"
+              << "  cone: generator cone bottomRadius height slices stacks outputfile\n"
+              << "  ring: generator ring outerRadius innerRadius slices outputfile\n"
+              << "  icosphere: generator icosphere radius subdivisions outputfile\n"
+              << "  cubesphere: generator cubesphere radius divisions outputfile\n"
+              << "  patch: generator patch patchfile tessellation outputfile\n"
+              << "  simplify: generator simplify inputfile ratio outputfile\n"
+              << "         (any .3d file; ratio is the fraction of triangles to keep, or a\n"
+              << "          triangle count if above 1)\n"
+              << "  bench: generator bench patchfile tessellation\n"
+              << "         (times the patch grid evaluation on one thread, per-point Bernstein\n"
+              << "          sums against the precomputed weights; nothing is written)\n"
+              << "  batch: generator batch manifestfile\n"
+              << "         (one model per line, as above without \"generator\"; '#' starts a comment,\n"
+              << "          \"quotes\" keep spaces in a path)\n"
+              << "Options:\n"
+              << "  --text      write the legacy text .3d format instead of binary\n"
+              << "  --quantize  store positions as 16-bit integers over the bounding box\n"
+              << "              (half the vertex size; error below extent / 65534)\n"
+              << "  --threads N worker threads for patch tessellation, the rows of a plane, sphere\n"
+              << "              or cone, or a batch (default: one per core)\n"
+              << "  --tolerance E  adaptive patch tessellation: chord error at most E,\n"
+              << "              with tessellation as the maximum level;\n"
+              << "              simplify: stop before the surface moves more than E\n"
+              << "  --max-error E  primitives: the least slices, stacks, subdivisions or divisions\n"
+              << "              that keep the surface within E of the exact shape (these\n"
+              << "              parameters may then be left out)\n"
+              << "  --lod N     write a chain of N levels of detail, halving the resolution\n"
+              << "              (slices, stacks, divisions or tessellation) at each level;\n"
+              << "              simplify keeps a quarter of the triangles per level\n"
+              << "  --optimize  reorder triangles and vertices for the GPU vertex cache\n"
+              << "  --stream    write a primitive as a plain triangle list while generating it,\n"
+              << "              in constant memory (always the case with --text)\n"
+              << "  --force     batch: rebuild outputs that are already up to date\n";
+}
+
+// Generates and writes one model. Returns false on bad arguments (nothing
+// written, usage set) or on a failed write; progress goes to log.
+static bool generateModel(const std::vector<std::string> &args, const Options &opt, std::ostream &log,
+                          bool &usage) {
+    usage = false;
+    size_t n = args.size();
+    std::string prim = n > 0 ? args[0] : "";
+    std::string filename = n > 0 ? args.back() : "";
+    // O nome do ficheiro do output será o nome dado pelo utilizador,
+    // o ficheiro vai ser guardado em models/generated tho
+    bool patch = prim == "patch" && n == 4;
+    bool simplify = prim == "simplify" && n == 4;
+    int tessellation = patch ? std::stoi(args[2]) : 0;
+    float tolerance = opt.tolerance;
+    std::vector<float> params;
+    for (size_t i = 1; !patch && !simplify && i + 1 < n; i++) params.push_back(std::stof(args[i]));
+    if (!patch && !simplify && opt.maxError > 0) {
+        if (n < 2 || !resolutionForError(prim, params, opt.maxError)) {
+            usage = true;
+            return false;
+        }
+        log << "Resolution for error " << opt.maxError << ":";
+        for (float p : params) log << " " << p;
+        log << std::endl;
+    }
+    Mesh input;
+    size_t target = 0;
+    if (simplify) {
+        if (!readMesh(args[1], input)) return false;
+        float ratio = std::stof(args[2]);
+        size_t triangles = input.indices.size() / 3;
+        target = ratio > 1 ? size_t(ratio) : size_t(ratio * triangles);
+        log << "Input: " << triangles << " triangles" << std::endl;
+    }
+    if (opt.lods > 1 && opt.format == ModelFormat::Text) {
+        log << "--lod needs the binary format" << std::endl;
+        return false;
+    }
+
+    // A plain triangle list can go to the file as it is generated. Welding,
+    // reordering and LODs need the whole mesh, as does quantizing (bounds).
+    bool primitive = !patch && !simplify;
+    if (primitive && (opt.stream || (opt.format == ModelFormat::Text && !opt.optimize && opt.lods == 1))) {
+        if (opt.optimize || opt.lods > 1 || opt.format == ModelFormat::Quantized) {
+            log << "--stream cannot be combined with --optimize, --lod or --quantize" << std::endl;
+            return false;
+        }
+        size_t count;
+        if (n < 2 || !primitiveVertexCount(prim, params, count)) {
+            usage = true;
+            return false;
+        }
+        return writePrimitive(prim, params, filename, opt.format, opt.threads);
+    }
+
+    // Level 0 is the requested resolution; each further level halves it.
+    std::vector<Mesh> levels;
+    std::vector<float> errors;
+    for (int l = 0; l < opt.lods; l++) {
+        Mesh mesh;
+        float error;
+        if (patch) {
+            mesh = bezier(args[1], tessellation, opt.threads, tolerance, &error);
+        } else if (simplify) {
+            mesh = simplifyMesh(input, target, tolerance, &error);
+            if (opt.lods == 1)
+                log << "Simplified to " << mesh.indices.size() / 3 << " triangles, error " << error << std::endl;
+        } else if (n < 2 || !generatePrimitive(prim, params, mesh, &error, opt.threads)) {
+            usage = true;
+            return false;
+        }
+        if (opt.optimize) {
+            double before = meshACMR(mesh);
+            optimizeMesh(mesh);
+            log << "ACMR " << before << " -> " << meshACMR(mesh) << std::endl;
+        }
+        levels.push_back(std::move(mesh));
+        errors.push_back(error);
+        if (opt.lods > 1)
+            log << "LOD " << l << ": " << levels.back().indices.size() / 3 << " triangles, error " << error << std::endl;
+        if (patch) {
+            if (tessellation == 1) break;
+            tessellation /= 2;
+            tolerance *= 4;   // chord error goes with 1 / tessellation^2
+        } else if (simplify) {
+            if (levels.back().indices.size() / 3 <= 1) break;
+            target = levels.back().indices.size() / 3 / 4;
+            tolerance *= 4;
+        } else if (!coarserPrimitive(prim, params)) {
+            break;
+        }
+    }
+    if (opt.lods > 1) return writeMeshLods(levels, errors, filename, opt.format);
+    // The binary format stores shared vertices once plus an index list;
+    // the text format stays a plain triangle list.
+    if (opt.format == ModelFormat::Text)
+        return writeVertices(expandMesh(levels[0]), filename, opt.format);
+    return writeMesh(levels[0], filename, opt.format);
+}
+
+static bool modifiedTime(const std::string &path, time_t &t) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) return false;
+    t = st.st_mtime;
+    return true;
+}
+
+// An output is up to date when it is newer than the manifest and, for a
+// patch or a simplified mesh, than its input file.
+static bool upToDate(const std::vector<std::string> &args, time_t manifestTime) {
+    time_t out, in;
+    if (args.size() < 2 || !modifiedTime(modelOutputPath(args.back()), out) || out < manifestTime)
+        return false;
+    bool hasInput = args[0] == "patch" || args[0] == "simplify";
+    return !hasInput || (modifiedTime(args[1], in) && out >= in);
+}
+
+// Splits a manifest line into words; "double quotes" keep spaces in a word
+// and '#' outside quotes starts a comment.
+static std::vector<std::string> splitWords(const std::string &line) {
+    std::vector<std::string> words;
+    std::string word;
+    bool quoted = false, any = false;
+    for (char c : line) {
+        if (c == '"') { quoted = !quoted; any = true; continue; }
+        if (!quoted && c == '#') break;
+        if (!quoted && (c == ' ' || c == '\t' || c == '\r')) {
+            if (any) words.push_back(word);
+            word.clear();
+            any = false;
+            continue;
+        }
+        word += c;
+        any = true;
+    }
+    if (any) words.push_back(word);
+    return words;
+}
+
+// Generates every model listed in the manifest on a thread pool. Each line
+// is "primitive args... outputfile [options]", with the command line's
+// options as defaults.
+static int runBatch(const std::string &manifest, const Options &defaults) {
+    std::ifstream in(manifest);
+    time_t manifestTime;
+    if (!in || !modifiedTime(manifest, manifestTime)) {
+        std::cerr << "Cannot open manifest: " << manifest << std::endl;
+        return 1;
+    }
+    struct Job {
+        int line;
+        std::vector<std::string> args;
+        Options opt;
+        std::string log;
+        bool ok = false, skipped = false, invalid = false;
+    };
+    std::vector<Job> jobs;
+    std::string line;
+    for (int lineNo = 1; std::getline(in, line); lineNo++) {
+        std::vector<std::string> tokens = splitWords(line);
+        if (tokens.empty()) continue;
+        Job job;
+        job.line = lineNo;
+        job.opt = defaults;
+        job.opt.threads = 1;   // the batch itself is the parallel loop
+        if (!parseArguments(tokens, job.opt, job.args)) {
+            job.invalid = true;
+            job.log = "invalid option\n";
+        }
+        jobs.push_back(job);
+    }
+
+    parallelFor(jobs.size(), defaults.threads, [&](size_t i) {
+        Job &job = jobs[i];
+        if (job.invalid) return;
+        if (!job.opt.force && upToDate(job.args, manifestTime)) {
+            job.ok = job.skipped = true;
+            return;
+        }
+        std::ostringstream log;
+        try {
+            bool usage;
+            job.ok = generateModel(job.args, job.opt, log, usage);
+            if (usage) log << "invalid model specification" << std::endl;
+        } catch (const std::exception &e) {
+            log << e.what() << std::endl;
+        }
+        job.log = log.str();
+    });
+
+    size_t built = 0, skipped = 0, failed = 0;
+    for (const Job &job : jobs) {
+        if (job.skipped) { skipped++; continue; }
+        if (job.ok) built++; else failed++;
+        std::istringstream log(job.log);
+        for (std::string l; std::getline(log, l);)
+            (job.ok ? std::cout : std::cerr) << manifest << ":" << job.line << ": " << l << "\n";
+    }
+    std::cout << built << " generated, " << skipped << " up to date, " << failed << " failed." << std::endl;
+    return failed ? 1 : 0;
+}
 
 int main(int argc, char **argv) {
-    if (argc > 1) {
-        std::string prim = argv[1];
-        std::vector<Vertex> verts;
-        // O nome do ficheiro do output será o nome dado pelo utilizador,
-        // o ficheiro vai ser guardado em models/generated tho
-        if (prim == "plane" && argc == 5) {
-            float dimension = std::stof(argv[2]);
-            int divisions = std::stoi(argv[3]);
-            std::string filename = argv[4];
-            verts = generatePlane(dimension, divisions);
-            writeVertices(verts, filename);
-        } else if (prim == "sphere" && argc == 6) {
-            float radius = std::stof(argv[2]);
-            int slices = std::stoi(argv[3]);
-            int stacks = std::stoi(argv[4]);
-            std::string filename = argv[5];
-            verts = generateSphere(radius, slices, stacks);
-            writeVertices(verts, filename);
-        } else if (prim == "box" && argc == 5) {
-            float dimension = std::stof(argv[2]);
-            int divisions = std::stoi(argv[3]);
-            std::string filename = argv[4];
-            verts = generateCube(dimension, divisions);
-            writeVertices(verts, filename);
-        } else if (prim == "cone" && argc == 7) {
-            float bottomRadius = std::stof(argv[2]);
-            float height = std::stof(argv[3]);
-            int slices = std::stoi(argv[4]);
-            int stacks = std::stoi(argv[5]);
-            std::string filename = argv[6];
-            verts = generateCone(bottomRadius, height, slices, stacks);
-            writeVertices(verts, filename);
-        } else if (prim == "ring" && argc == 6) {
-            float outerRadius = std::stof(argv[2]);
-            float innerRadius = std::stof(argv[3]);
-            int slices = std::stoi(argv[4]);
-            std::string filename = argv[5];
-            verts = generateRing(outerRadius, innerRadius, slices);
-            writeVertices(verts, filename);
-        } else if (prim == "patch" && argc == 5) {
-                std::string bezierFile = argv[2];
-                int tessellation       = std::stoi(argv[3]);
-                std::string filename   = argv[4];
-                verts = bezier(bezierFile, tessellation);
-                writeVertices(verts, filename);
-        } else {
-            std::cerr << "Usage:\n"
-                      << "  plane: generator plane dimension divisions outputfile\n"
-                      << "  sphere: generator sphere radius slices stacks outputfile\n"
-                      << "  box: generator box dimension divisions outputfile\n"
-                      << "  cone: generator cone bottomRadius height slices stacks outputfile\n";
+    Options opt;
+    std::vector<std::string> args;
+    if (!parseArguments(std::vector<std::string>(argv + 1, argv + argc), opt, args)) {
+        printUsage();
+        return 1;
+    }
+
+    if (!args.empty() && args[0] == "batch" && args.size() == 2)
+        return runBatch(args[1], opt);
+
+    if (!args.empty() && args[0] == "bench" && args.size() == 3) {
+        try {
+            benchmarkBezier(args[1], std::stoi(args[2]), std::cout);
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (!args.empty()) {
+        bool usage, ok;
+        try {
+            ok = generateModel(args, opt, std::cout, usage);
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        if (usage) {
+            printUsage();
             return 1;
         }
+        if (!ok) return 1;
         std::cout << "Primitive generated and saved in models/generated/ successfully." << std::endl;
         return 0;
     }
@@ -0,0 +1,182 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "parallel.h"
+#include "primitives.h"  // for Vertex and Mesh
+
+/// Tessellation of a parametric surface over a grid of rows x columns cells.
+/// The surface is a compile-time functor, so every primitive gets loops
+/// specialized (and vectorizable) for its own formula:
+///
+///     struct Surface {
+///         struct Row; struct Column;     // terms of one grid line (e.g. sin/cos)
+///         Row    row(int i) const;       // i in [0, rows]
+///         Column column(int j) const;    // j in [0, columns]
+///         Vertex point(const Row &r, const Column &c) const;
+///         bool   pole(int i) const;      // row i collapses to a single point
+///     };
+///
+/// row() and column() run once per grid line, so a grid point costs a few
+/// multiplications instead of trigonometry at every triangle corner. A pole
+/// row is the point at column 0; cell triangles with two corners on it are
+/// left out.
+///
+/// Each cell is cut into two triangles given as six corners, each one of
+/// 0 (i, j), 1 (i + 1, j), 2 (i + 1, j + 1) or 3 (i, j + 1).
+typedef int GridCut[6];
+
+/// Points of a grid row at count columns from table[first] on (a pole
+/// repeats its point).
+template <class Surface>
+void gridPoints(const Surface &surface, const typename Surface::Row &row, bool pole,
+                const typename Surface::Column *table, int first, int count, Vertex *out) {
+    if (pole) {
+        Vertex p = surface.point(row, table[0]);
+        for (int j = 0; j < count; j++) out[j] = p;
+        return;
+    }
+    for (int j = 0; j < count; j++) out[j] = surface.point(row, table[first + j]);
+}
+
+/// The column terms of a grid, computed once.
+template <class Surface>
+std::vector<typename Surface::Column> gridColumns(const Surface &surface, int columns) {
+    std::vector<typename Surface::Column> table(columns + 1);
+    for (int j = 0; j <= columns; j++) table[j] = surface.column(j);
+    return table;
+}
+
+/// Whether each triangle of cut is kept between a row and the next, given
+/// which of the two are poles.
+inline void gridKeep(const GridCut &cut, bool lowerPole, bool upperPole, bool keep[2]) {
+    for (int t = 0; t < 2; t++) {
+        int lower = 0, upper = 0;
+        for (int k = 0; k < 3; k++) {
+            int c = cut[t * 3 + k];
+            (c == 1 || c == 2 ? upper : lower)++;
+        }
+        keep[t] = !(lowerPole && lower > 1) && !(upperPole && upper > 1);
+    }
+}
+
+/// Number of vertices gridTriangles writes for row i.
+template <class Surface>
+size_t gridTriangleCount(const Surface &surface, int i, int columns, const GridCut &cut) {
+    bool keep[2];
+    gridKeep(cut, surface.pole(i), surface.pole(i + 1), keep);
+    return 3 * size_t(keep[0] + keep[1]) * size_t(columns);
+}
+
+/// Writes the triangles of the cells between rows i and i + 1 to out, cell
+/// by cell. Works on a block of columns at a time, so however wide the
+/// grid, its points stay in cache.
+template <class Surface>
+void gridTriangles(const Surface &surface, const std::vector<typename Surface::Column> &table, int i,
+                   const GridCut &cut, Vertex *out) {
+    const int kBlock = 256;
+    int columns = int(table.size()) - 1;
+    Vertex lower[kBlock + 1], upper[kBlock + 1];
+    // The corners of the kept triangles, as rows shifted by column.
+    const Vertex *line[4] = { lower, upper, upper + 1, lower + 1 };
+    bool keep[2];
+    gridKeep(cut, surface.pole(i), surface.pole(i + 1), keep);
+    const Vertex *corner[6];
+    int corners = 0;
+    for (int t = 0; t < 2; t++)
+        for (int k = 0; keep[t] && k < 3; k++) corner[corners++] = line[cut[t * 3 + k]];
+    typename Surface::Row below = surface.row(i), above = surface.row(i + 1);
+    for (int first = 0; first < columns; first += kBlock) {
+        int count = std::min(kBlock, columns - first);
+        gridPoints(surface, below, surface.pole(i), table.data(), first, count + 1, lower);
+        gridPoints(surface, above, surface.pole(i + 1), table.data(), first, count + 1, upper);
+        for (int j = 0; j < count; j++)
+            for (int k = 0; k < corners; k++) *out++ = corner[k][j];
+    }
+}
+
+/// Feeds the triangles of the grid, row by row, to the sink, on `threads`
+/// worker threads (0 = one per core). Rows are made a band at a time, each
+/// at an offset in the band counted beforehand, and every band goes to the
+/// sink in order: the output is the same for any thread count, and at most
+/// a band (about 12 MB per thread, or a row per thread if that is more) is
+/// held in memory.
+template <class Surface>
+void tessellateGrid(const Surface &surface, int rows, int columns, const GridCut &cut, VertexSink &sink,
+                    unsigned threads = 1) {
+    if (rows <= 0 || columns <= 0) return;
+    const size_t kBandVertices = size_t(1) << 20;
+    std::vector<typename Surface::Column> table = gridColumns(surface, columns);
+    unsigned workers = resolveThreadCount(threads);
+    size_t band = std::max<size_t>(workers, workers * kBandVertices / (6 * size_t(columns)));
+    band = std::min(band, size_t(rows));
+    std::vector<size_t> offset(band + 1);
+    std::vector<Vertex> triangles;
+    for (int first = 0; first < rows; first += int(band)) {
+        size_t count = std::min(band, size_t(rows - first));
+        for (size_t r = 0; r < count; r++)
+            offset[r + 1] = offset[r] + gridTriangleCount(surface, first + int(r), columns, cut);
+        triangles.resize(std::max(triangles.size(), offset[count]));
+        parallelFor(count, workers, [&](size_t r) {
+            gridTriangles(surface, table, first + int(r), cut, &triangles[offset[r]]);
+        });
+        sink.put(triangles.data(), offset[count]);
+    }
+}
+
+/// Appends the points of the grid to mesh.vertices, row by row and a pole
+/// once, on `threads` worker threads, and returns where each row starts
+/// (rows + 2 entries, the last one past the end).
+template <class Surface>
+std::vector<uint32_t> gridVertices(const Surface &surface, int rows, int columns, Mesh &mesh,
+                                   unsigned threads = 1) {
+    std::vector<uint32_t> start(rows + 2);
+    if (rows <= 0 || columns <= 0) {
+        start.assign(start.size(), uint32_t(mesh.vertices.size()));
+        return start;
+    }
+    std::vector<typename Surface::Column> table = gridColumns(surface, columns);
+    start[0] = uint32_t(mesh.vertices.size());
+    for (int i = 0; i <= rows; i++) start[i + 1] = start[i] + (surface.pole(i) ? 1 : columns + 1);
+    mesh.vertices.resize(start[rows + 1]);
+    parallelFor(size_t(rows) + 1, threads, [&](size_t i) {
+        gridPoints(surface, surface.row(int(i)), surface.pole(int(i)), table.data(), 0,
+                   int(start[i + 1] - start[i]), &mesh.vertices[start[i]]);
+    });
+    return start;
+}
+
+/// Appends the triangles of every cell of a grid made by gridVertices to
+/// mesh.indices, in the order tessellateGrid emits them, on `threads`
+/// worker threads.
+inline void gridIndices(const std::vector<uint32_t> &start, int columns, const GridCut &cut, Mesh &mesh,
+                        unsigned threads = 1) {
+    int rows = int(start.size()) - 2;
+    if (rows <= 0 || columns <= 0 || start[0] == start[rows + 1]) return;
+    // A pole row holds one point, which every column shares.
+    auto pole = [&](int i) { return start[i + 1] - start[i] == 1; };
+    std::vector<size_t> offset(rows + 1);
+    offset[0] = mesh.indices.size();
+    for (int i = 0; i < rows; i++) {
+        bool keep[2];
+        gridKeep(cut, pole(i), pole(i + 1), keep);
+        offset[i + 1] = offset[i] + 3 * size_t(keep[0] + keep[1]) * size_t(columns);
+    }
+    mesh.indices.resize(offset[rows]);
+    parallelFor(size_t(rows), threads, [&](size_t r) {
+        int i = int(r);
+        bool keep[2];
+        gridKeep(cut, pole(i), pole(i + 1), keep);
+        uint32_t base[4] = { start[i], start[i + 1], start[i + 1] + !pole(i + 1), start[i] + !pole(i) };
+        uint32_t step[4] = { !pole(i), !pole(i + 1), !pole(i + 1), !pole(i) };
+        uint32_t *out = &mesh.indices[offset[i]];
+        for (int j = 0; j < columns; j++)
+            for (int t = 0; t < 2; t++) {
+                if (!keep[t]) continue;
+                for (int k = 0; k < 3; k++) {
+                    int c = cut[t * 3 + k];
+                    *out++ = base[c] + step[c] * uint32_t(j);
+                }
+            }
+    });
+}
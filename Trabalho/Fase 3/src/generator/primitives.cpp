@@ -1,34 +1,184 @@
 #include "primitives.h"
-#include <fstream>
+#include "model3d.h"
+#include "parametric.h"
+#include "parallel.h"
 #include <iostream>
+#include <fstream>
+#include <iterator>
 #include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+
+
+//-------------------------------------------------------------------------
+// Output sinks
+//-------------------------------------------------------------------------
+
+namespace {
+
+// Gathers a generator's vertices into blocks so the sink is called once per
+// block rather than once per vertex.
+class VertexBlock {
+public:
+    explicit VertexBlock(VertexSink &sink) : sink_(sink) {}
+    ~VertexBlock() { flush(); }
+    void push(const Vertex &v) {
+        block_[count_++] = v;
+        if (count_ == kSize) flush();
+    }
+    void flush() {
+        if (count_) sink_.put(block_, count_);
+        count_ = 0;
+    }
+
+private:
+    static const size_t kSize = 3 * 1024;
+    VertexSink &sink_;
+    Vertex block_[kSize];
+    size_t count_ = 0;
+};
+
+class VectorSink : public VertexSink {
+public:
+    explicit VectorSink(std::vector<Vertex> &verts) : verts_(verts) {}
+    void put(const Vertex *verts, size_t count) override { verts_.insert(verts_.end(), verts, verts + count); }
+
+private:
+    std::vector<Vertex> &verts_;
+};
+
+class FileSink : public VertexSink {
+public:
+    explicit FileSink(Model3DStreamWriter &writer) : writer_(writer) {}
+    void put(const Vertex *verts, size_t count) override { ok_ = writer_.write(verts[0].data(), count) && ok_; }
+    bool ok() const { return ok_; }
+
+private:
+    Model3DStreamWriter &writer_;
+    bool ok_ = true;
+};
+
+}
+
+static size_t positive(int n) { return n > 0 ? size_t(n) : 0; }
+
+// Renumbers the vertices in the order the triangles first use them, which
+// is also the order model3dWeld gives them; unused vertices are dropped.
+// On several threads the indices are split into chunks: each vertex finds
+// the first chunk using it, then each chunk numbers the vertices it uses
+// first, in order, after those of the chunks before it. The numbering is
+// the same for any thread count.
+static void renumberByFirstUse(Mesh &mesh, unsigned threads = 1) {
+    const size_t kChunk = size_t(1) << 16;
+    size_t chunks = (mesh.indices.size() + kChunk - 1) / kChunk;
+    if (resolveThreadCount(threads) > 1 && chunks > 1) {
+        size_t vertCount = mesh.vertices.size();
+        std::vector<std::atomic<uint32_t>> firstChunk(vertCount);
+        std::vector<uint32_t> rank(vertCount, UINT32_MAX);
+        std::vector<size_t> offset(chunks + 1, 0);
+        parallelFor(vertCount, threads, [&](size_t v) { firstChunk[v].store(UINT32_MAX, std::memory_order_relaxed); });
+        auto range = [&](size_t c, size_t &begin, size_t &end) {
+            begin = c * kChunk;
+            end = std::min(begin + kChunk, mesh.indices.size());
+        };
+        parallelFor(chunks, threads, [&](size_t c) {
+            size_t begin, end;
+            range(c, begin, end);
+            for (size_t i = begin; i < end; i++) {
+                std::atomic<uint32_t> &f = firstChunk[mesh.indices[i]];
+                uint32_t seen = f.load(std::memory_order_relaxed);
+                while (seen > c && !f.compare_exchange_weak(seen, uint32_t(c), std::memory_order_relaxed)) {}
+            }
+        });
+        parallelFor(chunks, threads, [&](size_t c) {
+            size_t begin, end, count = 0;
+            range(c, begin, end);
+            for (size_t i = begin; i < end; i++) {
+                uint32_t v = mesh.indices[i];
+                if (firstChunk[v].load(std::memory_order_relaxed) == c && rank[v] == UINT32_MAX)
+                    rank[v] = uint32_t(count++);
+            }
+            offset[c + 1] = count;
+        });
+        for (size_t c = 0; c < chunks; c++) offset[c + 1] += offset[c];
+        std::vector<Vertex> vertices(offset[chunks]);
+        auto number = [&](uint32_t v) { return uint32_t(offset[firstChunk[v].load(std::memory_order_relaxed)] + rank[v]); };
+        parallelFor(vertCount, threads, [&](size_t v) {
+            if (rank[v] != UINT32_MAX) vertices[number(uint32_t(v))] = mesh.vertices[v];
+        });
+        parallelFor(chunks, threads, [&](size_t c) {
+            size_t begin, end;
+            range(c, begin, end);
+            for (size_t i = begin; i < end; i++) mesh.indices[i] = number(mesh.indices[i]);
+        });
+        mesh.vertices.swap(vertices);
+        return;
+    }
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+    std::vector<Vertex> vertices;
+    vertices.reserve(mesh.vertices.size());
+    for (uint32_t &v : mesh.indices) {
+        if (remap[v] == UINT32_MAX) {
+            remap[v] = uint32_t(vertices.size());
+            vertices.push_back(mesh.vertices[v]);
+        }
+        v = remap[v];
+    }
+    mesh.vertices.swap(vertices);
+}
+
 
 
 //-------------------------------------------------------------------------
 // Plane
 //-------------------------------------------------------------------------
 
+namespace {
+
+// Rows run along x, columns along z.
+struct PlaneSurface {
+    struct Row { float x; };
+    struct Column { float z; };
+    PlaneSurface(float dimension, int divisions) : half(dimension * 0.5f), step(dimension / divisions) {}
+    Row row(int i) const { return { -half + i * step }; }
+    Column column(int j) const { return { -half + j * step }; }
+    Vertex point(const Row &r, const Column &c) const { return { r.x, 0.0f, c.z }; }
+    bool pole(int) const { return false; }
+    float half, step;
+};
+
+// Two triangles per cell with reversed vertex order for an upright plane.
+const GridCut kPlaneCut = { 0, 2, 1, 0, 3, 2 };
+
+}
+
+size_t planeVertexCount(int divisions) {
+    return 6 * positive(divisions) * positive(divisions);
+}
+
+void generatePlane(float dimension, int divisions, VertexSink &sink, unsigned threads) {
+    tessellateGrid(PlaneSurface(dimension, divisions), divisions, divisions, kPlaneCut, sink, threads);
+}
+
+void generatePlane(float dimension, int divisions, Mesh &mesh, unsigned threads) {
+    mesh = Mesh();
+    PlaneSurface surface(dimension, divisions);
+    std::vector<uint32_t> start = gridVertices(surface, divisions, divisions, mesh, threads);
+    gridIndices(start, divisions, kPlaneCut, mesh, threads);
+    renumberByFirstUse(mesh, threads);
+}
+
 std::vector<Vertex> generatePlane(float dimension, int divisions) {
     std::vector<Vertex> verts;
-    float half = dimension * 0.5f;
-    float step = dimension / divisions;
-    for (int i = 0; i < divisions; i++) {
-        for (int j = 0; j < divisions; j++) {
-            float x0 = -half + i * step;
-            float x1 = -half + (i + 1) * step;
-            float z0 = -half + j * step;
-            float z1 = -half + (j + 1) * step;
-            // Two triangles per cell with reversed vertex order for an upright plane.
-            // First triangle: {x0, 0, z0}, {x1, 0, z1}, {x1, 0, z0}
-            verts.push_back({x0, 0.0f, z0});
-            verts.push_back({x1, 0.0f, z1});
-            verts.push_back({x1, 0.0f, z0});
-            // Second triangle: {x0, 0, z0}, {x0, 0, z1}, {x1, 0, z1}
-            verts.push_back({x0, 0.0f, z0});
-            verts.push_back({x0, 0.0f, z1});
-            verts.push_back({x1, 0.0f, z1});
-        }
-    }
+    verts.reserve(planeVertexCount(divisions));
+    VectorSink sink(verts);
+    generatePlane(dimension, divisions, sink);
     return verts;
 }
 
@@ -38,38 +188,52 @@ std::vector<Vertex> generatePlane(float dimension, int divisions) {
 // Sphere
 //-------------------------------------------------------------------------
 
+namespace {
+
+// Rows are parallels from the south pole up, columns meridians.
+struct SphereSurface {
+    struct Row { float r, y; };      // radius and height of the parallel
+    struct Column { float c, s; };   // cosine and sine of the longitude
+    SphereSurface(float radius, int slices, int stacks)
+        : radius(radius), stepStacks(M_PI / stacks), stepSlices(2 * M_PI / slices) {}
+    Row row(int i) const {
+        float lat = i * stepStacks - M_PI/2;
+        return { radius * cosf(lat), radius * sinf(lat) };
+    }
+    Column column(int j) const {
+        float angle = j * stepSlices;
+        return { cosf(angle), sinf(angle) };
+    }
+    Vertex point(const Row &r, const Column &c) const { return { r.r * c.c, r.y, r.r * c.s }; }
+    bool pole(int) const { return false; }
+    float radius, stepStacks, stepSlices;
+};
+
+const GridCut kSphereCut = { 0, 1, 2, 0, 2, 3 };
+
+}
+
+size_t sphereVertexCount(int slices, int stacks) {
+    return 6 * positive(slices) * positive(stacks);
+}
+
+void generateSphere(float radius, int slices, int stacks, VertexSink &sink, unsigned threads) {
+    tessellateGrid(SphereSurface(radius, slices, stacks), stacks, slices, kSphereCut, sink, threads);
+}
+
+void generateSphere(float radius, int slices, int stacks, Mesh &mesh, unsigned threads) {
+    mesh = Mesh();
+    SphereSurface surface(radius, slices, stacks);
+    std::vector<uint32_t> start = gridVertices(surface, stacks, slices, mesh, threads);
+    gridIndices(start, slices, kSphereCut, mesh, threads);
+    renumberByFirstUse(mesh, threads);
+}
+
 std::vector<Vertex> generateSphere(float radius, int slices, int stacks) {
     std::vector<Vertex> verts;
-    float step_stacks = M_PI / stacks;
-    float step_slices = 2 * M_PI / slices;
-    for (int i = 0; i < stacks; i++) {
-        float lat1 = i * step_stacks - M_PI/2;
-        float lat2 = (i + 1) * step_stacks - M_PI/2;
-        for (int j = 0; j < slices; j++) {
-            float angle = j * step_slices;
-            float angle2 = (j + 1) * step_slices;
-            // First triangle.
-            float x1 = radius * cosf(lat1) * cosf(angle);
-            float y1 = radius * sinf(lat1);
-            float z1 = radius * cosf(lat1) * sinf(angle);
-            float x2 = radius * cosf(lat2) * cosf(angle);
-            float y2 = radius * sinf(lat2);
-            float z2 = radius * cosf(lat2) * sinf(angle);
-            float x3 = radius * cosf(lat2) * cosf(angle2);
-            float y3 = radius * sinf(lat2);
-            float z3 = radius * cosf(lat2) * sinf(angle2);
-            verts.push_back({x1, y1, z1});
-            verts.push_back({x2, y2, z2});
-            verts.push_back({x3, y3, z3});
-            // Second triangle.
-            float x6 = radius * cosf(lat1) * cosf(angle2);
-            float y6 = radius * sinf(lat1);
-            float z6 = radius * cosf(lat1) * sinf(angle2);
-            verts.push_back({x1, y1, z1});
-            verts.push_back({x3, y3, z3});
-            verts.push_back({x6, y6, z6});
-        }
-    }
+    verts.reserve(sphereVertexCount(slices, stacks));
+    VectorSink sink(verts);
+    generateSphere(radius, slices, stacks, sink);
     return verts;
 }
 
@@ -80,8 +244,12 @@ std::vector<Vertex> generateSphere(float radius, int slices, int stacks) {
 // Cube
 //-------------------------------------------------------------------------
 
-std::vector<Vertex> generateCube(float dimension, int divisions) {
-    std::vector<Vertex> verts;
+size_t cubeVertexCount(int divisions) {
+    return 6 * planeVertexCount(divisions);
+}
+
+void generateCube(float dimension, int divisions, VertexSink &sink) {
+    VertexBlock out(sink);
     float half = dimension * 0.5f;
     float step = dimension / divisions;
 
@@ -110,15 +278,22 @@ std::vector<Vertex> generateCube(float dimension, int divisions) {
                 Vertex v2 = trans(x1, y1, z);
                 Vertex v3 = trans(x0, y1, z);
                 // Two triangles per face patch.
-                verts.push_back(v0);
-                verts.push_back(v1);
-                verts.push_back(v2);
-                verts.push_back(v0);
-                verts.push_back(v2);
-                verts.push_back(v3);
+                out.push(v0);
+                out.push(v1);
+                out.push(v2);
+                out.push(v0);
+                out.push(v2);
+                out.push(v3);
             }
         }
     }
+}
+
+std::vector<Vertex> generateCube(float dimension, int divisions) {
+    std::vector<Vertex> verts;
+    verts.reserve(cubeVertexCount(divisions));
+    VectorSink sink(verts);
+    generateCube(dimension, divisions, sink);
     return verts;
 }
 
@@ -128,45 +303,88 @@ std::vector<Vertex> generateCube(float dimension, int divisions) {
 // Cone
 //-------------------------------------------------------------------------
 
-std::vector<Vertex> generateCone(float bottomRadius, float height, int slices, int stacks) {
-    std::vector<Vertex> verts;
+namespace {
+
+// Rows are stacks from the base up to the apex, a pole; columns are slices.
+struct ConeSurface {
+    struct Row { float r, y; };
+    struct Column { float c, s; };
+    ConeSurface(float bottomRadius, float height, int slices, int stacks)
+        : bottomRadius(bottomRadius), height(height), slices(slices), stacks(stacks) {}
+    Row row(int i) const {
+        if (i == stacks) return { 0.0f, height };
+        float f = float(i) / stacks;
+        return { bottomRadius * (1.0f - f), f * height };
+    }
+    Column column(int j) const {
+        float angle = 2 * M_PI * j / slices;
+        return { cosf(angle), sinf(angle) };
+    }
+    Vertex point(const Row &r, const Column &c) const { return { r.r * c.c, r.y, r.r * c.s }; }
+    bool pole(int i) const { return i == stacks; }
+    // Point of the base's rim at a column.
+    Vertex rim(const Column &c) const { return { bottomRadius * c.c, 0.0f, bottomRadius * c.s }; }
+    float bottomRadius, height;
+    int slices, stacks;
+};
+
+// Only the first triangle is left in the top stack.
+const GridCut kConeCut = { 0, 2, 3, 0, 1, 2 };
+
+}
+
+size_t coneVertexCount(int slices, int stacks) {
+    // The base, then two triangles per side cell but one in the top stack.
+    return stacks > 0 ? 6 * positive(slices) * positive(stacks) : 3 * positive(slices);
+}
+
+void generateCone(float bottomRadius, float height, int slices, int stacks, VertexSink &sink, unsigned threads) {
+    if (slices <= 0) return;
+    ConeSurface surface(bottomRadius, height, slices, stacks);
+    std::vector<ConeSurface::Column> table = gridColumns(surface, slices);
     // Base of the cone.
-    for (int j = 0; j < slices; j++){
-        float angle0 = 2 * M_PI * j / slices;
-        float angle1 = 2 * M_PI * (j + 1) / slices;
-        verts.push_back({bottomRadius * cosf(angle1), 0.0f, bottomRadius * sinf(angle1)});
-        verts.push_back({0.0f, 0.0f, 0.0f});
-        verts.push_back({bottomRadius * cosf(angle0), 0.0f, bottomRadius * sinf(angle0)});
+    {
+        VertexBlock out(sink);
+        for (int j = 0; j < slices; j++) {
+            out.push(surface.rim(table[j + 1]));
+            out.push({0.0f, 0.0f, 0.0f});
+            out.push(surface.rim(table[j]));
+        }
     }
     // Lateral surface.
-    for (int i = 0; i < stacks; i++){
-        float f0 = float(i) / stacks;
-        float f1 = float(i + 1) / stacks;
-        float y0 = f0 * height;
-        float y1 = f1 * height;
-        float r0 = bottomRadius * (1.0f - f0);
-        float r1 = bottomRadius * (1.0f - f1);
-        for (int j = 0; j < slices; j++){
-            float angle0 = 2 * M_PI * j / slices;
-            float angle1 = 2 * M_PI * (j + 1) / slices;
-            float x0 = r0 * cosf(angle0), z0 = r0 * sinf(angle0);
-            float x1 = r0 * cosf(angle1), z1 = r0 * sinf(angle1);
-            float x2 = r1 * cosf(angle1), z2 = r1 * sinf(angle1);
-            float x3 = r1 * cosf(angle0), z3 = r1 * sinf(angle0);
-            if (i < stacks - 1) {
-                verts.push_back({x0, y0, z0});
-                verts.push_back({x2, y1, z2});
-                verts.push_back({x1, y0, z1});
-                verts.push_back({x0, y0, z0});
-                verts.push_back({x3, y1, z3});
-                verts.push_back({x2, y1, z2});
-            } else {
-                verts.push_back({x0, y0, z0});
-                verts.push_back({0.0f, height, 0.0f});
-                verts.push_back({x1, y0, z1});
-            }
-        }
+    tessellateGrid(surface, stacks, slices, kConeCut, sink, threads);
+}
+
+void generateCone(float bottomRadius, float height, int slices, int stacks, Mesh &mesh, unsigned threads) {
+    mesh = Mesh();
+    if (slices <= 0) return;
+    ConeSurface surface(bottomRadius, height, slices, stacks);
+    std::vector<uint32_t> start = gridVertices(surface, stacks, slices, mesh, threads);
+    std::vector<ConeSurface::Column> table = gridColumns(surface, slices);
+    // The base's rim is the bottom row of the side wherever their points are
+    // the same.
+    uint32_t center = uint32_t(mesh.vertices.size());
+    mesh.vertices.push_back({0.0f, 0.0f, 0.0f});
+    std::vector<uint32_t> rim(slices + 1);
+    for (int j = 0; j <= slices; j++) {
+        Vertex p = surface.rim(table[j]);
+        bool shared = start[1] > start[0] && std::memcmp(&p, &mesh.vertices[start[0] + j], sizeof p) == 0;
+        rim[j] = shared ? start[0] + j : uint32_t(mesh.vertices.size());
+        if (!shared) mesh.vertices.push_back(p);
+    }
+    for (int j = 0; j < slices; j++) {
+        uint32_t tri[3] = { rim[j + 1], center, rim[j] };
+        mesh.indices.insert(mesh.indices.end(), tri, tri + 3);
     }
+    gridIndices(start, slices, kConeCut, mesh, threads);
+    renumberByFirstUse(mesh, threads);
+}
+
+std::vector<Vertex> generateCone(float bottomRadius, float height, int slices, int stacks) {
+    std::vector<Vertex> verts;
+    verts.reserve(coneVertexCount(slices, stacks));
+    VectorSink sink(verts);
+    generateCone(bottomRadius, height, slices, stacks, sink);
     return verts;
 }
 
@@ -176,89 +394,690 @@ std::vector<Vertex> generateCone(float bottomRadius, float height, int slices, i
 // Ring
 //-------------------------------------------------------------------------
 
-// Recursive Ring Aux func
-void generateRingAux(std::vector<Vertex>& verts,
-                           int currentSlice, int slices,
-                           float outerRadius, float innerRadius, float step)
-{
-    if (currentSlice >= slices) return;
+namespace {
 
-    float angle = currentSlice * step;
-    float nextAngle = (currentSlice + 1) * step;
+// Two rows, the inner circle and the outer one; columns are slices.
+struct RingSurface {
+    struct Row { float r; };
+    struct Column { float c, s; };
+    RingSurface(float outerRadius, float innerRadius, int slices)
+        : outerRadius(outerRadius), innerRadius(innerRadius), step(2.0f * M_PI / slices) {}
+    Row row(int i) const { return { i == 0 ? innerRadius : outerRadius }; }
+    Column column(int j) const {
+        float angle = j * step;
+        return { cosf(angle), sinf(angle) };
+    }
+    Vertex point(const Row &r, const Column &c) const { return { r.r * c.c, 0.0f, r.r * c.s }; }
+    bool pole(int) const { return false; }
+    float outerRadius, innerRadius, step;
+};
 
-    // Outter circle coordinates
-    float outerX0 = outerRadius * cosf(angle);
-    float outerZ0 = outerRadius * sinf(angle);
-    float outerX1 = outerRadius * cosf(nextAngle);
-    float outerZ1 = outerRadius * sinf(nextAngle);
+// The top (counter-clockwise seen from above), then the same triangles
+// reversed for the bottom, visible from below.
+const GridCut kRingTopCut = { 0, 1, 2, 0, 2, 3 };
+const GridCut kRingBottomCut = { 2, 1, 0, 3, 2, 0 };
 
-    // Inner circle coordinates
-    float innerX0 = innerRadius * cosf(angle);
-    float innerZ0 = innerRadius * sinf(angle);
-    float innerX1 = innerRadius * cosf(nextAngle);
-    float innerZ1 = innerRadius * sinf(nextAngle);
+}
 
-    // First triangle (top)
-    verts.push_back({innerX0, 0.0f, innerZ0});
-    verts.push_back({outerX0, 0.0f, outerZ0});
-    verts.push_back({outerX1, 0.0f, outerZ1});
+size_t ringVertexCount(int slices) {
+    return 12 * positive(slices);
+}
 
-    // Second triangle (top)
-    verts.push_back({innerX0, 0.0f, innerZ0});
-    verts.push_back({outerX1, 0.0f, outerZ1});
-    verts.push_back({innerX1, 0.0f, innerZ1});
+void generateRing(float outerRadius, float innerRadius, int slices, VertexSink &sink) {
+    RingSurface surface(outerRadius, innerRadius, slices);
+    tessellateGrid(surface, 1, slices, kRingTopCut, sink);
+    tessellateGrid(surface, 1, slices, kRingBottomCut, sink);
+}
 
-    generateRingAux(verts, currentSlice + 1, slices,
-                          outerRadius, innerRadius, step);
+// Both sides share the points of the grid.
+void generateRing(float outerRadius, float innerRadius, int slices, Mesh &mesh) {
+    mesh = Mesh();
+    std::vector<uint32_t> start = gridVertices(RingSurface(outerRadius, innerRadius, slices), 1, slices, mesh);
+    gridIndices(start, slices, kRingTopCut, mesh);
+    gridIndices(start, slices, kRingBottomCut, mesh);
+    renumberByFirstUse(mesh);
 }
 
-std::vector<Vertex> generateRing(float outerRadius, float innerRadius, int slices)
-{
+std::vector<Vertex> generateRing(float outerRadius, float innerRadius, int slices) {
     std::vector<Vertex> verts;
+    verts.reserve(ringVertexCount(slices));
+    VectorSink sink(verts);
+    generateRing(outerRadius, innerRadius, slices, sink);
+    return verts;
+}
+
+
+
+
+
+//-------------------------------------------------------------------------
+// Icosphere and cube sphere
+//-------------------------------------------------------------------------
 
-    // 1) Gen. of Top side triangles (counter-clockwise drawn)
-    float step = 2.0f * M_PI / slices;
-    generateRingAux(verts, 0, slices, outerRadius, innerRadius, step);
+// Both meshes keep their triangles close to equilateral and evenly spread
+// over the sphere, with no poles. Every point is computed from integer grid
+// coordinates in a fixed order, so the faces meeting along an edge compute
+// bit-identical vertices and the mesh welds closed.
 
-    // 2) Make a double of those triangles in reversed order to create the bottom of the ring
-    //    that is visible from below (clockwise drawn).
-    size_t topVertexCount = verts.size();
-    for (size_t i = 0; i < topVertexCount; i += 3) {
-        // Counter clockwise triangle is (A, B, C).
-        // therefore, clockwise is: (C, B, A).
-        Vertex A = verts[i + 0];
-        Vertex B = verts[i + 1];
-        Vertex C = verts[i + 2];
+namespace {
 
-        // Push reversed
-        verts.push_back(C);
-        verts.push_back(B);
-        verts.push_back(A);
+const double kGolden = 1.6180339887498949;
+const double kIcosahedron[12][3] = {
+    { -1,  kGolden, 0 }, { 1,  kGolden, 0 }, { -1, -kGolden, 0 }, { 1, -kGolden, 0 },
+    { 0, -1,  kGolden }, { 0, 1,  kGolden }, { 0, -1, -kGolden }, { 0, 1, -kGolden },
+    {  kGolden, 0, -1 }, {  kGolden, 0, 1 }, { -kGolden, 0, -1 }, { -kGolden, 0, 1 },
+};
+// Counter-clockwise seen from outside.
+const int kIcosahedronFaces[20][3] = {
+    { 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+    { 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+    { 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+    { 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 },
+};
+
+// Cube faces as (axis of the face, sign, axis of u, axis of v), with u x v
+// pointing out.
+const int kCubeFaces[6][4] = {
+    { 0, 1, 1, 2 }, { 0, -1, 2, 1 }, { 1, 1, 2, 0 }, { 1, -1, 0, 2 }, { 2, 1, 0, 1 }, { 2, -1, 1, 0 },
+};
+
+Vertex onSphere(const double p[3], float radius) {
+    double len = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+    return { float(p[0] / len * radius), float(p[1] / len * radius), float(p[2] / len * radius) };
+}
+
+// Point of an icosahedron face at integer weights of its corners, summed in
+// corner index order and without the zero weights: the same point on the
+// faces sharing it.
+Vertex icospherePoint(const int face[3], const int weight[3], float radius) {
+    int order[3] = { 0, 1, 2 };
+    std::sort(order, order + 3, [&](int a, int b) { return face[a] < face[b]; });
+    double p[3] = { 0, 0, 0 };
+    for (int o : order) {
+        if (weight[o] == 0) continue;
+        for (int k = 0; k < 3; k++) p[k] += weight[o] * kIcosahedron[face[o]][k];
+    }
+    return onSphere(p, radius);
+}
+
+// Calls triangle(a, b, c) for the triangles of the first faces of an
+// icosahedron whose edges are split into n segments each.
+template <class F>
+void icosphereTriangles(float radius, int n, int faces, F triangle) {
+    std::vector<Vertex> above, below;
+    for (int f = 0; f < faces; f++) {
+        const int *face = kIcosahedronFaces[f];
+        // Row i holds the i + 1 points with weights (n - i, i - j, j).
+        auto row = [&](int i, std::vector<Vertex> &out) {
+            out.resize(i + 1);
+            for (int j = 0; j <= i; j++) {
+                int weight[3] = { n - i, i - j, j };
+                out[j] = icospherePoint(face, weight, radius);
+            }
+        };
+        row(0, above);
+        for (int i = 0; i < n; i++) {
+            row(i + 1, below);
+            for (int j = 0; j <= i; j++) {
+                triangle(above[j], below[j], below[j + 1]);
+                if (j < i) triangle(above[j], below[j + 1], above[j + 1]);
+            }
+            above.swap(below);
+        }
     }
+}
 
+// Point of the cube sphere at integer cube coordinates in [-n, n]. Each
+// coordinate is warped by tan so the cells span even angles.
+Vertex cubeSpherePoint(const int c[3], int n, float radius) {
+    double p[3];
+    for (int k = 0; k < 3; k++) p[k] = std::tan(M_PI / 4 * c[k] / n);
+    return onSphere(p, radius);
+}
+
+// Calls triangle(a, b, c) for the triangles of the first faces of a cube
+// sphere of n by n cells per face.
+template <class F>
+void cubeSphereTriangles(float radius, int n, int faces, F triangle) {
+    std::vector<Vertex> lower(n + 1), upper(n + 1);
+    for (int f = 0; f < faces; f++) {
+        const int *face = kCubeFaces[f];
+        auto row = [&](int j, std::vector<Vertex> &out) {
+            for (int i = 0; i <= n; i++) {
+                int c[3];
+                c[face[0]] = face[1] * n;
+                c[face[2]] = 2 * i - n;
+                c[face[3]] = 2 * j - n;
+                out[i] = cubeSpherePoint(c, n, radius);
+            }
+        };
+        row(0, lower);
+        for (int j = 0; j < n; j++) {
+            row(j + 1, upper);
+            for (int i = 0; i < n; i++) {
+                // Cut each cell along the diagonal that points at the face
+                // center, which is the shorter one of its skewed cells.
+                if ((2 * i + 1 < n) == (2 * j + 1 < n)) {
+                    triangle(lower[i], lower[i + 1], upper[i + 1]);
+                    triangle(lower[i], upper[i + 1], upper[i]);
+                } else {
+                    triangle(lower[i], lower[i + 1], upper[i]);
+                    triangle(lower[i + 1], upper[i + 1], upper[i]);
+                }
+            }
+            lower.swap(upper);
+        }
+    }
+}
+
+// Largest distance from a triangle with corners on the sphere to the sphere:
+// the radius less the distance from the center to the nearest point of the
+// triangle (on its plane, or else on an edge).
+struct SphereDeviation {
+    explicit SphereDeviation(float r) : radius(r) {}
+    float  radius;
+    double error = 0;
+    void operator()(const Vertex &a, const Vertex &b, const Vertex &c) {
+        const Vertex *corner[3] = { &a, &b, &c };
+        double e[3][3], n[3];
+        for (int i = 0; i < 3; i++)
+            for (int k = 0; k < 3; k++) e[i][k] = double((*corner[(i + 1) % 3])[k]) - (*corner[i])[k];
+        n[0] = e[0][1] * e[1][2] - e[0][2] * e[1][1];
+        n[1] = e[0][2] * e[1][0] - e[0][0] * e[1][2];
+        n[2] = e[0][0] * e[1][1] - e[0][1] * e[1][0];
+        double len2 = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+        if (len2 == 0) return;
+        // The center's foot on the plane is inside if it is on the inner
+        // side of every edge.
+        double plane = (n[0] * a[0] + n[1] * a[1] + n[2] * a[2]) / len2;
+        double foot[3] = { n[0] * plane, n[1] * plane, n[2] * plane };
+        bool inside = true;
+        double nearest2 = std::numeric_limits<double>::max();
+        for (int i = 0; i < 3; i++) {
+            const Vertex &p = *corner[i];
+            double toFoot[3] = { foot[0] - p[0], foot[1] - p[1], foot[2] - p[2] };
+            double side = (e[i][1] * toFoot[2] - e[i][2] * toFoot[1]) * n[0]
+                        + (e[i][2] * toFoot[0] - e[i][0] * toFoot[2]) * n[1]
+                        + (e[i][0] * toFoot[1] - e[i][1] * toFoot[0]) * n[2];
+            if (side < 0) inside = false;
+            // Nearest point of the edge to the center.
+            double edge2 = e[i][0] * e[i][0] + e[i][1] * e[i][1] + e[i][2] * e[i][2];
+            double t = -(p[0] * e[i][0] + p[1] * e[i][1] + p[2] * e[i][2]) / edge2;
+            t = std::min(1.0, std::max(0.0, t));
+            double d2 = 0;
+            for (int k = 0; k < 3; k++) d2 += (p[k] + t * e[i][k]) * (p[k] + t * e[i][k]);
+            nearest2 = std::min(nearest2, d2);
+        }
+        if (inside) nearest2 = foot[0] * foot[0] + foot[1] * foot[1] + foot[2] * foot[2];
+        error = std::max(error, std::fabs(radius) - std::sqrt(nearest2));
+    }
+};
+
+}
+
+size_t icosphereVertexCount(int subdivisions) {
+    return 60 * positive(subdivisions) * positive(subdivisions);
+}
+
+void generateIcosphere(float radius, int subdivisions, VertexSink &sink) {
+    VertexBlock out(sink);
+    icosphereTriangles(radius, subdivisions, 20, [&](const Vertex &a, const Vertex &b, const Vertex &c) {
+        out.push(a);
+        out.push(b);
+        out.push(c);
+    });
+}
+
+std::vector<Vertex> generateIcosphere(float radius, int subdivisions) {
+    std::vector<Vertex> verts;
+    verts.reserve(icosphereVertexCount(subdivisions));
+    VectorSink sink(verts);
+    generateIcosphere(radius, subdivisions, sink);
+    return verts;
+}
+
+size_t cubeSphereVertexCount(int divisions) {
+    return 36 * positive(divisions) * positive(divisions);
+}
+
+void generateCubeSphere(float radius, int divisions, VertexSink &sink) {
+    VertexBlock out(sink);
+    cubeSphereTriangles(radius, divisions, 6, [&](const Vertex &a, const Vertex &b, const Vertex &c) {
+        out.push(a);
+        out.push(b);
+        out.push(c);
+    });
+}
+
+std::vector<Vertex> generateCubeSphere(float radius, int divisions) {
+    std::vector<Vertex> verts;
+    verts.reserve(cubeSphereVertexCount(divisions));
+    VectorSink sink(verts);
+    generateCubeSphere(radius, divisions, sink);
+    return verts;
+}
+
+// The faces are all alike, so one of them gives the error of the whole mesh.
+static float icosphereError(float radius, int subdivisions) {
+    SphereDeviation deviation(radius);
+    icosphereTriangles(radius, subdivisions, 1, std::ref(deviation));
+    return float(deviation.error);
+}
+
+static float cubeSphereError(float radius, int divisions) {
+    SphereDeviation deviation(radius);
+    cubeSphereTriangles(radius, divisions, 1, std::ref(deviation));
+    return float(deviation.error);
+}
+
+
+
+
+
+//-------------------------------------------------------------------------
+// Indexed meshes
+//-------------------------------------------------------------------------
+
+static_assert(sizeof(Vertex) == 3 * sizeof(float), "Vertex must be three packed floats");
+
+Mesh buildIndexedMesh(const std::vector<Vertex> &verts) {
+    Mesh mesh;
+    std::vector<float> unique;
+    model3dWeld(verts.empty() ? nullptr : verts[0].data(), verts.size(), unique, mesh.indices);
+    mesh.vertices.resize(unique.size() / 3);
+    for (size_t i = 0; i < mesh.vertices.size(); i++)
+        mesh.vertices[i] = {unique[i * 3], unique[i * 3 + 1], unique[i * 3 + 2]};
+    return mesh;
+}
+
+// Sagitta of a circle of radius r split into n segments: the distance from
+// a chord to the arc it replaces. Worked out in double: in float the cosine
+// rounds to 1 from a few thousand segments on, and the error to 0.
+static float chordError(float r, int n) {
+    return float(std::fabs(double(r)) * (1.0 - std::cos(M_PI / n)));
+}
+
+bool primitiveVertexCount(const std::string &name, const std::vector<float> &p, size_t &count) {
+    if (name == "plane" && p.size() == 2) count = planeVertexCount(int(p[1]));
+    else if (name == "sphere" && p.size() == 3) count = sphereVertexCount(int(p[1]), int(p[2]));
+    else if (name == "box" && p.size() == 2) count = cubeVertexCount(int(p[1]));
+    else if (name == "cone" && p.size() == 4) count = coneVertexCount(int(p[2]), int(p[3]));
+    else if (name == "ring" && p.size() == 3) count = ringVertexCount(int(p[2]));
+    else if (name == "icosphere" && p.size() == 2) count = icosphereVertexCount(int(p[1]));
+    else if (name == "cubesphere" && p.size() == 2) count = cubeSphereVertexCount(int(p[1]));
+    else return false;
+    return true;
+}
+
+bool generatePrimitive(const std::string &name, const std::vector<float> &p, VertexSink &sink, unsigned threads) {
+    if (name == "plane" && p.size() == 2) generatePlane(p[0], int(p[1]), sink, threads);
+    else if (name == "sphere" && p.size() == 3) generateSphere(p[0], int(p[1]), int(p[2]), sink, threads);
+    else if (name == "box" && p.size() == 2) generateCube(p[0], int(p[1]), sink);
+    else if (name == "cone" && p.size() == 4) generateCone(p[0], p[1], int(p[2]), int(p[3]), sink, threads);
+    else if (name == "ring" && p.size() == 3) generateRing(p[0], p[1], int(p[2]), sink);
+    else if (name == "icosphere" && p.size() == 2) generateIcosphere(p[0], int(p[1]), sink);
+    else if (name == "cubesphere" && p.size() == 2) generateCubeSphere(p[0], int(p[1]), sink);
+    else return false;
+    return true;
+}
+
+// How far a primitive strays from its exact surface (parameters already
+// checked by primitiveVertexCount).
+static float primitiveError(const std::string &name, const std::vector<float> &p) {
+    // Meridians are half circles: stacks segments over an angle of pi.
+    if (name == "sphere") return chordError(p[0], int(p[1])) + chordError(p[0], 2 * int(p[2]));
+    if (name == "cone") return chordError(p[0], int(p[2]));
+    if (name == "ring") return chordError(p[0], int(p[2]));
+    if (name == "icosphere") return icosphereError(p[0], int(p[1]));
+    if (name == "cubesphere") return cubeSphereError(p[0], int(p[1]));
+    return 0;   // planes and boxes are exact at any resolution
+}
+
+bool generatePrimitive(const std::string &name, const std::vector<float> &p, Mesh &mesh, float *error,
+                       unsigned threads) {
+    size_t count;
+    if (!primitiveVertexCount(name, p, count)) return false;
+    // The grid primitives index their grid points directly; the others weld
+    // their triangle list.
+    if (name == "plane") {
+        generatePlane(p[0], int(p[1]), mesh, threads);
+    } else if (name == "sphere") {
+        generateSphere(p[0], int(p[1]), int(p[2]), mesh, threads);
+    } else if (name == "cone") {
+        generateCone(p[0], p[1], int(p[2]), int(p[3]), mesh, threads);
+    } else if (name == "ring") {
+        generateRing(p[0], p[1], int(p[2]), mesh);
+    } else {
+        std::vector<Vertex> verts;
+        verts.reserve(count);
+        VectorSink sink(verts);
+        generatePrimitive(name, p, sink);
+        mesh = buildIndexedMesh(verts);
+    }
+    if (error) *error = primitiveError(name, p);
+    return true;
+}
+
+namespace {
+
+// Resolution parameters of a primitive and the least each one can go down
+// to; the ones before the first are its shape (radius, dimensions).
+struct Resolution { const char *name; size_t index[2]; int minimum[2]; };
+const Resolution kResolution[] = {
+    { "plane",      { 1, 0 }, { 1, 0 } },
+    { "sphere",     { 1, 2 }, { 3, 2 } },
+    { "box",        { 1, 0 }, { 1, 0 } },
+    { "cone",       { 2, 3 }, { 3, 1 } },
+    { "ring",       { 2, 0 }, { 3, 0 } },
+    { "icosphere",  { 1, 0 }, { 1, 0 } },
+    { "cubesphere", { 1, 0 }, { 1, 0 } },
+};
+
+const Resolution *findResolution(const std::string &name) {
+    for (const Resolution &r : kResolution)
+        if (name == r.name) return &r;
+    return nullptr;
+}
+
+// Least resolution from minimum up whose error(n) is at most maxError,
+// assuming the error shrinks as n grows: doubling, then bisection. 0 if
+// even kMaxResolution is not enough, or if doubling stops lowering the error
+// (the float vertices cannot get any closer).
+const int kMaxResolution = 1 << 14;
+
+template <class F>
+int leastResolution(int minimum, float maxError, F error) {
+    float last = error(minimum);
+    if (last <= maxError) return minimum;
+    int bad = minimum, good = std::min(minimum * 2, kMaxResolution);
+    for (float e; (e = error(good)) > maxError; last = e) {
+        if (good == kMaxResolution || e >= last) return 0;
+        bad = good;
+        good = std::min(good * 2, kMaxResolution);
+    }
+    while (good - bad > 1) {
+        int mid = bad + (good - bad) / 2;
+        if (error(mid) <= maxError) good = mid;
+        else bad = mid;
+    }
+    return good;
+}
+
+}
+
+bool coarserPrimitive(const std::string &name, std::vector<float> &p) {
+    const Resolution *r = findResolution(name);
+    if (!r) return false;
+    bool changed = false;
+    for (int k = 0; k < 2 && r->minimum[k]; k++) {
+        if (r->index[k] >= p.size()) return false;
+        int n = int(p[r->index[k]]), half = std::max(n / 2, r->minimum[k]);
+        if (half < n) { p[r->index[k]] = float(half); changed = true; }
+    }
+    return changed;
+}
+
+bool resolutionForError(const std::string &name, std::vector<float> &p, float maxError) {
+    const Resolution *r = findResolution(name);
+    size_t shape = r ? r->index[0] : 0;
+    size_t full = r ? size_t(std::max(r->index[0], r->index[1])) + 1 : 0;
+    if (!r || (p.size() != shape && p.size() != full)) return false;
+    // Missing resolutions start at their minimum (e.g. the cone's stacks,
+    // which don't change its error).
+    for (size_t i = p.size(); i < full; i++) p.push_back(float(r->minimum[r->index[0] == i ? 0 : 1]));
+    float radius = p[0];
+    bool reached = true;
+    auto set = [&](size_t i, int n) {
+        p[i] = float(n);
+        reached = reached && n > 0;
+    };
+    if (name == "sphere") {
+        // Half the budget to the parallels, half to the meridians.
+        set(1, leastResolution(3, maxError / 2, [&](int n) { return chordError(radius, n); }));
+        set(2, leastResolution(2, maxError / 2, [&](int n) { return chordError(radius, 2 * n); }));
+    } else if (name == "cone" || name == "ring") {
+        set(2, leastResolution(3, maxError, [&](int n) { return chordError(radius, n); }));
+    } else if (name == "icosphere") {
+        set(1, leastResolution(1, maxError, [&](int n) { return icosphereError(radius, n); }));
+    } else if (name == "cubesphere") {
+        set(1, leastResolution(1, maxError, [&](int n) { return cubeSphereError(radius, n); }));
+    }
+    if (!reached) {
+        std::ostringstream msg;
+        msg << "No " << name << " resolution up to " << kMaxResolution << " is within error " << maxError;
+        throw std::runtime_error(msg.str());
+    }
+    return true;   // planes and boxes are exact at any resolution
+}
+
+std::vector<Vertex> expandMesh(const Mesh &mesh) {
+    std::vector<Vertex> verts;
+    verts.reserve(mesh.indices.size());
+    for (uint32_t i : mesh.indices) verts.push_back(mesh.vertices[i]);
     return verts;
 }
 
 
 
+//-------------------------------------------------------------------------
+// Vertex cache optimization (Forsyth, "Linear-Speed Vertex Cache
+// Optimisation"): greedily emits the triangle whose vertices score best in
+// a simulated LRU cache, favouring recently used vertices and vertices with
+// few triangles left.
+//-------------------------------------------------------------------------
+
+static const int kCacheSize = 32;
+
+static float vertexScore(int cachePos, int trisLeft) {
+    if (trisLeft == 0) return -1.0f;
+    float score = 0.0f;
+    if (cachePos >= 0)
+        score = cachePos < 3 ? 0.75f   // in the last triangle: no gain from reusing it right away
+                             : std::pow(1.0f - float(cachePos - 3) / (kCacheSize - 3), 1.5f);
+    return score + 2.0f / std::sqrt(float(trisLeft));
+}
+
+double meshACMR(const Mesh &mesh, int cacheSize) {
+    size_t triangles = mesh.indices.size() / 3;
+    if (triangles == 0) return 0.0;
+    std::vector<size_t> loadedAt(mesh.vertices.size(), 0);   // miss that loaded it, 0 = never
+    size_t misses = 0;
+    for (uint32_t v : mesh.indices)
+        if (loadedAt[v] == 0 || misses - loadedAt[v] >= size_t(cacheSize))
+            loadedAt[v] = ++misses;
+    return double(misses) / triangles;
+}
+
+void optimizeMesh(Mesh &mesh) {
+    size_t triCount = mesh.indices.size() / 3, vertCount = mesh.vertices.size();
+    if (triCount == 0) return;
+    const std::vector<uint32_t> &in = mesh.indices;
+
+    // Triangles of each vertex (CSR)
+    std::vector<int> trisLeft(vertCount, 0);
+    for (uint32_t v : in) trisLeft[v]++;
+    std::vector<size_t> firstTri(vertCount + 1, 0);
+    for (size_t v = 0; v < vertCount; v++) firstTri[v + 1] = firstTri[v] + trisLeft[v];
+    std::vector<uint32_t> vertTris(in.size());
+    std::vector<size_t> fill(firstTri.begin(), firstTri.end() - 1);
+    for (size_t t = 0; t < triCount; t++)
+        for (int k = 0; k < 3; k++) vertTris[fill[in[t * 3 + k]]++] = uint32_t(t);
+
+    std::vector<int> cachePos(vertCount, -1);
+    std::vector<float> vScore(vertCount), tScore(triCount, 0.0f);
+    for (size_t v = 0; v < vertCount; v++) vScore[v] = vertexScore(-1, trisLeft[v]);
+    for (size_t t = 0; t < triCount; t++)
+        for (int k = 0; k < 3; k++) tScore[t] += vScore[in[t * 3 + k]];
+    std::vector<bool> emitted(triCount, false);
+
+    std::vector<uint32_t> out;
+    out.reserve(in.size());
+    std::vector<uint32_t> cache, next;
+    size_t best = 0, scan = 0;
+    for (size_t t = 1; t < triCount; t++)
+        if (tScore[t] > tScore[best]) best = t;
+
+    while (true) {
+        emitted[best] = true;
+        const uint32_t *tri = &in[best * 3];
+        out.insert(out.end(), tri, tri + 3);
+
+        // The triangle's vertices move to the front of the LRU cache.
+        next.assign(tri, tri + 3);
+        for (uint32_t v : cache)
+            if (v != tri[0] && v != tri[1] && v != tri[2]) next.push_back(v);
+        // Its vertices drop it from their live triangles (the first trisLeft).
+        for (int k = 0; k < 3; k++) {
+            uint32_t v = tri[k];
+            size_t last = firstTri[v] + --trisLeft[v];
+            for (size_t i = firstTri[v]; i < last; i++)
+                if (vertTris[i] == best) { std::swap(vertTris[i], vertTris[last]); break; }
+        }
+        cache.swap(next);
+
+        // Rescore the vertices whose cache position changed, and their triangles.
+        for (size_t i = 0; i < cache.size(); i++) {
+            uint32_t v = cache[i];
+            cachePos[v] = i < size_t(kCacheSize) ? int(i) : -1;
+            float s = vertexScore(cachePos[v], trisLeft[v]);
+            float delta = s - vScore[v];
+            vScore[v] = s;
+            for (size_t j = firstTri[v]; j < firstTri[v] + trisLeft[v]; j++) tScore[vertTris[j]] += delta;
+        }
+        if (cache.size() > size_t(kCacheSize)) cache.resize(kCacheSize);
+
+        // Next: the best triangle touching the cache, else the next unused one.
+        float bestScore = -1.0f;
+        for (uint32_t v : cache)
+            for (size_t j = firstTri[v]; j < firstTri[v] + trisLeft[v]; j++) {
+                uint32_t t = vertTris[j];
+                if (!emitted[t] && tScore[t] > bestScore) { bestScore = tScore[t]; best = t; }
+            }
+        if (bestScore < 0.0f) {
+            while (scan < triCount && emitted[scan]) scan++;
+            if (scan == triCount) break;
+            best = scan;
+        }
+    }
+
+    // Vertex fetch order: renumber vertices by first use.
+    mesh.indices.swap(out);
+    renumberByFirstUse(mesh);
+}
+
 
 
 //-------------------------------------------------------------------------
 // Write vertices to a .3d file in the "models/generated/" directory.
 //-------------------------------------------------------------------------
 
-void writeVertices(const std::vector<Vertex> &verts, const std::string &filename) {
-    std::string outputPath = "../models/generated/" + filename;
-    std::ofstream file(outputPath);
-    
-    if (!file.is_open()){
-        std::cerr << "Error opening file: " << outputPath << std::endl;
-        return;
+bool readMesh(const std::string &path, Mesh &mesh) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "Error opening file: " << path << std::endl;
+        return false;
+    }
+    std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (!model3dIsBinary(data.data(), data.size())) {
+        std::vector<float> soup;
+        if (!model3dParseText(data.data(), data.size(), soup, path)) return false;
+        std::vector<Vertex> verts(soup.size() / 3);
+        for (size_t i = 0; i < verts.size(); i++) verts[i] = {soup[i*3], soup[i*3+1], soup[i*3+2]};
+        mesh = buildIndexedMesh(verts);
+        return true;
+    }
+
+    Model3DView view;
+    if (!model3dParse(data.data(), data.size(), view, path)) return false;
+    const Model3DHeader &h = *view.header;
+    std::vector<Vertex> verts(h.vertexCount);
+    if (h.layout == MODEL3D_LAYOUT_POS3F) {
+        std::memcpy(verts.data(), view.vertices, view.vertexBytes);
+    } else {
+        const int16_t *q = static_cast<const int16_t *>(view.vertices);
+        for (size_t i = 0; i < verts.size(); i++)
+            for (int k = 0; k < 3; k++) verts[i][k] = h.quantOffset[k] + q[i*3 + k] * h.quantScale[k];
+    }
+    if (view.indexCount == 0) {
+        mesh = buildIndexedMesh(verts);
+        return true;
+    }
+    uint32_t first = view.lodCount ? view.lods[0].firstIndex : 0;
+    uint32_t count = view.lodCount ? view.lods[0].indexCount : view.indexCount;
+    mesh.vertices = std::move(verts);
+    mesh.indices.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const char *p = static_cast<const char *>(view.indices) + size_t(first + i) * view.indexSize;
+        if (view.indexSize == 2) {
+            uint16_t v;
+            std::memcpy(&v, p, 2);
+            mesh.indices[i] = v;
+        } else {
+            std::memcpy(&mesh.indices[i], p, 4);
+        }
+        if (mesh.indices[i] >= mesh.vertices.size()) {
+            std::cerr << "Invalid .3d index data: " << path << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string modelOutputPath(const std::string &filename) {
+    return "../models/generated/" + filename;
+}
+
+bool writeVertices(const std::vector<Vertex> &verts, const std::string &filename, ModelFormat format) {
+    std::string outputPath = modelOutputPath(filename);
+    if (format != ModelFormat::Text)
+        return model3dWrite(outputPath, verts.empty() ? nullptr : verts[0].data(), verts.size(), nullptr, 0,
+                            format == ModelFormat::Quantized ? MODEL3D_LAYOUT_POS3S16 : MODEL3D_LAYOUT_POS3F);
+    return model3dWriteText(outputPath, verts.empty() ? nullptr : verts[0].data(), verts.size());
+}
+
+bool writePrimitive(const std::string &name, const std::vector<float> &params, const std::string &filename,
+                    ModelFormat format, unsigned threads) {
+    size_t count;
+    if (!primitiveVertexCount(name, params, count)) {
+        std::cerr << "Invalid primitive: " << name << std::endl;
+        return false;
+    }
+    if (format == ModelFormat::Quantized) {
+        std::cerr << "Quantized output cannot be streamed: " << filename << std::endl;
+        return false;
+    }
+    Model3DStreamWriter writer;
+    if (!writer.open(modelOutputPath(filename), format == ModelFormat::Text, count)) return false;
+    FileSink sink(writer);
+    generatePrimitive(name, params, sink, threads);
+    bool closed = writer.close();
+    return sink.ok() && closed;
+}
+
+bool writeMesh(const Mesh &mesh, const std::string &filename, ModelFormat format) {
+    return model3dWrite(modelOutputPath(filename), mesh.vertices.empty() ? nullptr : mesh.vertices[0].data(),
+                        mesh.vertices.size(), mesh.indices.data(), mesh.indices.size(),
+                        format == ModelFormat::Quantized ? MODEL3D_LAYOUT_POS3S16 : MODEL3D_LAYOUT_POS3F);
+}
+
+bool writeMeshLods(const std::vector<Mesh> &levels, const std::vector<float> &errors,
+                   const std::string &filename, ModelFormat format) {
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<Model3DLod> lods;
+    for (size_t i = 0; i < levels.size(); i++) {
+        const Mesh &m = levels[i];
+        Model3DLod lod = {};
+        lod.firstIndex = uint32_t(indices.size());
+        lod.indexCount = uint32_t(m.indices.size());
+        lod.error = errors[i];
+        lods.push_back(lod);
+        uint32_t base = uint32_t(vertices.size());
+        vertices.insert(vertices.end(), m.vertices.begin(), m.vertices.end());
+        for (uint32_t v : m.indices) indices.push_back(base + v);
     }
-    // Write the number of vertices.
-    file << verts.size() << "\n";
-    
-    for (const auto &v : verts)
-        file << v[0] << " " << v[1] << " " << v[2] << "\n";
-    file.close();
+    return model3dWrite(modelOutputPath(filename), vertices.empty() ? nullptr : vertices[0].data(),
+                        vertices.size(), indices.data(), indices.size(),
+                        format == ModelFormat::Quantized ? MODEL3D_LAYOUT_POS3S16 : MODEL3D_LAYOUT_POS3F,
+                        lods.data(), lods.size());
 }
@@ -4,27 +4,149 @@
 #include <vector>
 #include <array>
 #include <string>
+#include <cstddef>
+#include <cstdint>
 
 // Each vertex is represented by an array of 3 floats.
 typedef std::array<float, 3> Vertex;
 
-// Generates the vertices for a plane centered at the origin.
+// Unique vertices plus a triangle list indexing into them.
+struct Mesh {
+    std::vector<Vertex>   vertices;
+    std::vector<uint32_t> indices;
+};
+
+// Encoding of the .3d output: binary (see common/model3d.h), binary with 16-bit
+// quantized positions, or the legacy text format.
+enum class ModelFormat { Binary, Quantized, Text };
+
+// Receives a generator's triangle list in order, a block of vertices at a
+// time (three per triangle, blocks end on a triangle boundary), so a model
+// can go straight to a file or a buffer without ever being held whole.
+class VertexSink {
+public:
+    virtual ~VertexSink() {}
+    virtual void put(const Vertex *verts, size_t count) = 0;
+};
+
+// Generates the vertices for a plane centered at the origin, as a triangle
+// list, or as an indexed mesh of its grid points. The grid primitives
+// (plane, sphere, cone) split their rows over `threads` worker threads
+// (0 = one per core); the result is the same for any thread count.
 std::vector<Vertex> generatePlane(float dimension, int divisions);
+void generatePlane(float dimension, int divisions, VertexSink &sink, unsigned threads = 1);
+void generatePlane(float dimension, int divisions, Mesh &mesh, unsigned threads = 1);
+size_t planeVertexCount(int divisions);
 
 // Generates the vertices for a sphere centered at the origin.
 std::vector<Vertex> generateSphere(float radius, int slices, int stacks);
+void generateSphere(float radius, int slices, int stacks, VertexSink &sink, unsigned threads = 1);
+void generateSphere(float radius, int slices, int stacks, Mesh &mesh, unsigned threads = 1);
+size_t sphereVertexCount(int slices, int stacks);
 
 // Generates the vertices for a cube centered at the origin.
 std::vector<Vertex> generateCube(float dimension, int divisions);
+void generateCube(float dimension, int divisions, VertexSink &sink);
+size_t cubeVertexCount(int divisions);
 
 // Generates the vertices for a cone with its base on the XZ plane.
 std::vector<Vertex> generateCone(float bottomRadius, float height, int slices, int stacks);
+void generateCone(float bottomRadius, float height, int slices, int stacks, VertexSink &sink,
+                  unsigned threads = 1);
+void generateCone(float bottomRadius, float height, int slices, int stacks, Mesh &mesh, unsigned threads = 1);
+size_t coneVertexCount(int slices, int stacks);
 
 // Generates the vertices for a ring in the XZ plane, centered at the origin.
 std::vector<Vertex> generateRing(float outerRadius, float innerRadius, int slices);
+void generateRing(float outerRadius, float innerRadius, int slices, VertexSink &sink);
+void generateRing(float outerRadius, float innerRadius, int slices, Mesh &mesh);
+size_t ringVertexCount(int slices);
+
+// Generates the vertices for a geodesic sphere centered at the origin: an
+// icosahedron with each edge split into subdivisions segments, pushed out to
+// the sphere (20 * subdivisions^2 triangles).
+std::vector<Vertex> generateIcosphere(float radius, int subdivisions);
+void generateIcosphere(float radius, int subdivisions, VertexSink &sink);
+size_t icosphereVertexCount(int subdivisions);
+
+// Generates the vertices for a cube sphere centered at the origin: a cube of
+// divisions x divisions cells per face, pushed out to the sphere with the
+// cells spanning even angles (12 * divisions^2 triangles).
+std::vector<Vertex> generateCubeSphere(float radius, int divisions);
+void generateCubeSphere(float radius, int divisions, VertexSink &sink);
+size_t cubeSphereVertexCount(int divisions);
+
+// Builds a primitive by name (plane, sphere, box, cone, ring, icosphere,
+// cubesphere) from its parameters in command-line order, e.g. sphere: radius
+// slices stacks, as a welded indexed mesh. Returns false for an unknown name or parameter count.
+// error, if given, receives how far the mesh strays from the exact surface.
+// threads as for generatePlane.
+bool generatePrimitive(const std::string &name, const std::vector<float> &params, Mesh &mesh,
+                       float *error = nullptr, unsigned threads = 1);
+
+// The same, as a triangle list fed to sink.
+bool generatePrimitive(const std::string &name, const std::vector<float> &params, VertexSink &sink,
+                       unsigned threads = 1);
+
+// Exact number of vertices the triangle list of a primitive will have.
+bool primitiveVertexCount(const std::string &name, const std::vector<float> &params, size_t &count);
+
+// Halves the slices, stacks or divisions of a primitive's parameters for the
+// next coarser level of detail. Returns false once none can be halved.
+bool coarserPrimitive(const std::string &name, std::vector<float> &params);
+
+// Sets the slices, stacks, subdivisions or divisions of a primitive to the
+// least that keeps it within maxError of the exact surface (for a sphere,
+// the chord deviation at its radius). params may stop before the resolution
+// parameters, which are then added. Returns false for an unknown name or
+// parameter count; throws std::runtime_error if no resolution up to 16384
+// is fine enough.
+bool resolutionForError(const std::string &name, std::vector<float> &params, float maxError);
 
 
+// Welds the shared vertices of a triangle soup into an indexed mesh.
+Mesh buildIndexedMesh(const std::vector<Vertex> &verts);
+
+// Expands an indexed mesh back into a triangle soup.
+std::vector<Vertex> expandMesh(const Mesh &mesh);
+
+// Average cache miss ratio (vertex loads per triangle) of the index order,
+// for a FIFO post-transform cache of cacheSize vertices. 0.5 is the ideal for
+// a large grid, 3 means no reuse at all.
+double meshACMR(const Mesh &mesh, int cacheSize = 16);
+
+// Reorders the triangles for post-transform vertex cache locality (Forsyth),
+// then renumbers the vertices in first-use order for fetch locality. The
+// triangles themselves (and their winding) are unchanged.
+void optimizeMesh(Mesh &mesh);
+
+// Reads any .3d file (text, or binary of any version and layout) as an
+// indexed mesh; plain triangle lists are welded, LOD files give their finest
+// level. Returns false (after printing why) on a missing or invalid file.
+bool readMesh(const std::string &path, Mesh &mesh);
+
+// Where an output file name ends up: the "models/generated/" directory.
+std::string modelOutputPath(const std::string &filename);
+
 // Writes the vertices to a .3d file in the "models/generated/" directory.
-void writeVertices(const std::vector<Vertex> &verts, const std::string &filename);
+// Returns false (after printing why) if the file could not be written.
+bool writeVertices(const std::vector<Vertex> &verts, const std::string &filename,
+                   ModelFormat format = ModelFormat::Binary);
+
+// Generates a primitive straight into a .3d triangle list (text, or binary
+// without an index list) in the "models/generated/" directory, holding at
+// most a band of rows of it in memory. Quantized output needs
+// the bounds first and cannot be streamed.
+bool writePrimitive(const std::string &name, const std::vector<float> &params, const std::string &filename,
+                    ModelFormat format = ModelFormat::Binary, unsigned threads = 1);
+
+// Writes an indexed mesh as a binary .3d file in the "models/generated/" directory.
+bool writeMesh(const Mesh &mesh, const std::string &filename, ModelFormat format = ModelFormat::Binary);
+
+// Writes a chain of levels of detail, finest first, as one binary .3d file:
+// the levels share a vertex block and each has its own index range and
+// error (see Model3DLod).
+bool writeMeshLods(const std::vector<Mesh> &levels, const std::vector<float> &errors,
+                   const std::string &filename, ModelFormat format = ModelFormat::Binary);
 
 #endif // PRIMITIVES_H
@@ -0,0 +1,307 @@
+#include "simplify.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <vector>
+
+namespace {
+
+struct Vec3d { double x, y, z; };
+
+Vec3d operator-(const Vec3d &a, const Vec3d &b) { return {a.x - b.x, a.y - b.y, a.z - b.z}; }
+double dot(const Vec3d &a, const Vec3d &b) { return a.x*b.x + a.y*b.y + a.z*b.z; }
+Vec3d cross(const Vec3d &a, const Vec3d &b) {
+    return {a.y*b.z - a.z*b.y, a.z*b.x - a.x*b.z, a.x*b.y - a.y*b.x};
+}
+
+// Sum of squared distances to a set of planes, as the symmetric 4x4 matrix
+// of n.x n.y n.z d (upper triangle, row by row).
+struct Quadric {
+    double a[10] = {};
+
+    void addPlane(const Vec3d &n, double d, double w) {
+        double p[4] = {n.x, n.y, n.z, d};
+        int k = 0;
+        for (int i = 0; i < 4; ++i)
+            for (int j = i; j < 4; ++j) a[k++] += w * p[i] * p[j];
+    }
+    Quadric &operator+=(const Quadric &q) {
+        for (int k = 0; k < 10; ++k) a[k] += q.a[k];
+        return *this;
+    }
+    double error(const Vec3d &p) const {
+        double e = a[0]*p.x*p.x + 2*a[1]*p.x*p.y + 2*a[2]*p.x*p.z + 2*a[3]*p.x
+                 + a[4]*p.y*p.y + 2*a[5]*p.y*p.z + 2*a[6]*p.y
+                 + a[7]*p.z*p.z + 2*a[8]*p.z + a[9];
+        return e > 0 ? e : 0;
+    }
+    // The point of least error, if the 3x3 part is well conditioned.
+    bool minimum(Vec3d &p) const {
+        double m00 = a[0], m01 = a[1], m02 = a[2], m11 = a[4], m12 = a[5], m22 = a[7];
+        double c0 = m11*m22 - m12*m12, c1 = m02*m12 - m01*m22, c2 = m01*m12 - m02*m11;
+        double det = m00*c0 + m01*c1 + m02*c2;
+        double t = m00 + m11 + m22;
+        if (!(std::fabs(det) > 1e-9 * t*t*t)) return false;
+        double b0 = -a[3], b1 = -a[6], b2 = -a[8];
+        p.x = (b0*c0 + b1*c1 + b2*c2) / det;
+        p.y = (b0*c1 + b1*(m00*m22 - m02*m02) + b2*(m01*m02 - m00*m12)) / det;
+        p.z = (b0*c2 + b1*(m01*m02 - m00*m12) + b2*(m00*m11 - m01*m01)) / det;
+        return true;
+    }
+};
+
+// Weight of the plane that pins a boundary edge, against 1 per triangle.
+const double kBoundaryWeight = 100.0;
+
+// Smallest cosine between a triangle's normal before and after a collapse.
+const double kMaxFold = 0.1;
+
+struct Candidate {
+    double   cost;
+    uint32_t u, v;             // v collapses into u
+    Vec3d    p;
+};
+
+// Heap entries stay small; the target point is worked out again on pop.
+struct QueuedEdge {
+    float    cost;
+    uint32_t u, v;
+    uint32_t stampU, stampV;   // stale once either end changes
+    bool operator<(const QueuedEdge &o) const { return cost > o.cost; }   // min-heap
+};
+
+class Simplifier {
+public:
+    explicit Simplifier(const Mesh &mesh);
+    Mesh run(size_t targetTriangles, float maxError, float *error);
+
+private:
+    Candidate candidate(uint32_t u, uint32_t v) const;
+    QueuedEdge queued(uint32_t u, uint32_t v) const;
+    void prune(uint32_t x);
+    void neighbours(uint32_t x, std::vector<uint32_t> &out);
+    bool canCollapse(const Candidate &c);
+    void collapse(const Candidate &c);
+    Vec3d normal(const std::array<uint32_t,3> &f, uint32_t moved, const Vec3d &p) const;
+
+    std::vector<Vec3d>                   pos_;
+    std::vector<Quadric>                 quadric_;
+    std::vector<std::array<uint32_t,3>>  faces_;
+    std::vector<char>                    faceRemoved_;
+    std::vector<std::vector<uint32_t>>   vertexFaces_;
+    std::vector<uint32_t>                stamp_;
+    std::vector<char>                    removed_, boundary_;
+    std::priority_queue<QueuedEdge>      heap_;
+    size_t                               live_ = 0;
+    std::vector<uint32_t>                nu_, nv_;   // scratch for canCollapse
+};
+
+Simplifier::Simplifier(const Mesh &mesh)
+    : pos_(mesh.vertices.size()), quadric_(mesh.vertices.size()), vertexFaces_(mesh.vertices.size()),
+      stamp_(mesh.vertices.size(), 0), removed_(mesh.vertices.size(), 0), boundary_(mesh.vertices.size(), 0) {
+    for (size_t i = 0; i < pos_.size(); ++i)
+        pos_[i] = {mesh.vertices[i][0], mesh.vertices[i][1], mesh.vertices[i][2]};
+
+    // Every edge once, keyed (low, high), with the faces along it.
+    std::vector<std::pair<uint64_t, uint32_t>> edges;
+    edges.reserve(mesh.indices.size());
+    for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+        std::array<uint32_t,3> f = {{mesh.indices[t], mesh.indices[t+1], mesh.indices[t+2]}};
+        if (f[0] == f[1] || f[1] == f[2] || f[0] == f[2]) continue;
+        uint32_t id = uint32_t(faces_.size());
+        faces_.push_back(f);
+        Vec3d n = normal(f, UINT32_MAX, Vec3d());
+        double len = std::sqrt(dot(n, n));
+        if (len > 0) {
+            n = {n.x / len, n.y / len, n.z / len};
+            Quadric q;
+            q.addPlane(n, -dot(n, pos_[f[0]]), 1.0);
+            for (uint32_t x : f) quadric_[x] += q;
+        }
+        for (int k = 0; k < 3; ++k) {
+            vertexFaces_[f[k]].push_back(id);
+            uint32_t a = f[k], b = f[(k+1) % 3];
+            edges.push_back(std::make_pair(uint64_t(std::min(a, b)) << 32 | std::max(a, b), id));
+        }
+    }
+    faceRemoved_.assign(faces_.size(), 0);
+    live_ = faces_.size();
+
+    std::sort(edges.begin(), edges.end());
+    for (size_t i = 0; i < edges.size();) {
+        size_t j = i;
+        while (j < edges.size() && edges[j].first == edges[i].first) ++j;
+        uint32_t a = uint32_t(edges[i].first >> 32), b = uint32_t(edges[i].first);
+        if (j - i == 1) {
+            // Boundary: a plane through the edge, perpendicular to its face.
+            boundary_[a] = boundary_[b] = 1;
+            Vec3d e = pos_[b] - pos_[a];
+            Vec3d m = cross(e, normal(faces_[edges[i].second], UINT32_MAX, Vec3d()));
+            double len = std::sqrt(dot(m, m));
+            if (len > 0) {
+                m = {m.x / len, m.y / len, m.z / len};
+                Quadric q;
+                q.addPlane(m, -dot(m, pos_[a]), kBoundaryWeight);
+                quadric_[a] += q;
+                quadric_[b] += q;
+            }
+        }
+        i = j;
+    }
+    std::vector<QueuedEdge> initial;
+    for (size_t i = 0; i < edges.size(); ++i)
+        if (i == 0 || edges[i].first != edges[i-1].first)
+            initial.push_back(queued(uint32_t(edges[i].first >> 32), uint32_t(edges[i].first)));
+    heap_ = std::priority_queue<QueuedEdge>(std::less<QueuedEdge>(), std::move(initial));
+}
+
+// Unnormalized normal of f, with vertex moved (if any) placed at p.
+Vec3d Simplifier::normal(const std::array<uint32_t,3> &f, uint32_t moved, const Vec3d &p) const {
+    const Vec3d &a = f[0] == moved ? p : pos_[f[0]];
+    const Vec3d &b = f[1] == moved ? p : pos_[f[1]];
+    const Vec3d &c = f[2] == moved ? p : pos_[f[2]];
+    return cross(b - a, c - a);
+}
+
+// Best target of collapsing edge (u, v): the quadric minimum when it is well
+// defined and near the edge, otherwise the better end or the midpoint.
+Candidate Simplifier::candidate(uint32_t u, uint32_t v) const {
+    Quadric q = quadric_[u];
+    q += quadric_[v];
+    const Vec3d &a = pos_[u], &b = pos_[v];
+    Vec3d mid = {(a.x + b.x) / 2, (a.y + b.y) / 2, (a.z + b.z) / 2};
+    Candidate c = {q.error(a), u, v, a};
+    const Vec3d options[2] = {b, mid};
+    for (const Vec3d &p : options) {
+        double e = q.error(p);
+        if (e < c.cost) { c.cost = e; c.p = p; }
+    }
+    Vec3d p, d = b - a;
+    if (q.minimum(p)) {
+        Vec3d off = p - mid;
+        double e = q.error(p);
+        if (dot(off, off) <= dot(d, d) && e < c.cost) { c.cost = e; c.p = p; }
+    }
+    return c;
+}
+
+QueuedEdge Simplifier::queued(uint32_t u, uint32_t v) const {
+    QueuedEdge e = {float(candidate(u, v).cost), u, v, stamp_[u], stamp_[v]};
+    return e;
+}
+
+// Drops the faces of x that are gone; the lists are only pruned on use.
+void Simplifier::prune(uint32_t x) {
+    std::vector<uint32_t> &fs = vertexFaces_[x];
+    fs.erase(std::remove_if(fs.begin(), fs.end(), [this](uint32_t f) { return faceRemoved_[f] != 0; }), fs.end());
+}
+
+// Vertices sharing a face with x, sorted (the faces of x must be pruned).
+void Simplifier::neighbours(uint32_t x, std::vector<uint32_t> &out) {
+    out.clear();
+    for (uint32_t f : vertexFaces_[x])
+        for (uint32_t y : faces_[f])
+            if (y != x) out.push_back(y);
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+bool Simplifier::canCollapse(const Candidate &c) {
+    // Link condition: u and v may only share the neighbours opposite the
+    // edge, one per face along it; any other makes the result non-manifold.
+    prune(c.u);
+    prune(c.v);
+    size_t shared = 0;
+    for (uint32_t f : vertexFaces_[c.u])
+        if (faces_[f][0] == c.v || faces_[f][1] == c.v || faces_[f][2] == c.v) shared++;
+    if (shared == 0) return false;
+    // Two borders joined through the interior would pinch the mesh.
+    if (boundary_[c.u] && boundary_[c.v] && shared > 1) return false;
+    neighbours(c.u, nu_);
+    neighbours(c.v, nv_);
+    size_t common = 0;
+    for (size_t i = 0, j = 0; i < nu_.size() && j < nv_.size();) {
+        if (nu_[i] < nv_[j]) ++i;
+        else if (nv_[j] < nu_[i]) ++j;
+        else { common++; ++i; ++j; }
+    }
+    if (common != shared) return false;
+
+    // No surviving face may fold over or collapse to a sliver.
+    for (uint32_t x : {c.u, c.v})
+        for (uint32_t f : vertexFaces_[x]) {
+            const std::array<uint32_t,3> &t = faces_[f];
+            bool hasU = t[0] == c.u || t[1] == c.u || t[2] == c.u;
+            bool hasV = t[0] == c.v || t[1] == c.v || t[2] == c.v;
+            if (hasU && hasV) continue;
+            Vec3d before = normal(t, UINT32_MAX, Vec3d());
+            Vec3d after = normal(t, x, c.p);
+            double lb = dot(before, before), la = dot(after, after);
+            if (la == 0 || dot(before, after) < kMaxFold * std::sqrt(lb * la)) return false;
+        }
+    return true;
+}
+
+void Simplifier::collapse(const Candidate &c) {
+    pos_[c.u] = c.p;
+    quadric_[c.u] += quadric_[c.v];
+    boundary_[c.u] |= boundary_[c.v];
+    removed_[c.v] = 1;
+    stamp_[c.u]++;
+    for (uint32_t f : vertexFaces_[c.v]) {
+        std::array<uint32_t,3> &t = faces_[f];
+        if (t[0] == c.u || t[1] == c.u || t[2] == c.u) {
+            faceRemoved_[f] = 1;
+            live_--;
+            continue;
+        }
+        for (uint32_t &x : t)
+            if (x == c.v) x = c.u;
+        vertexFaces_[c.u].push_back(f);
+    }
+    std::vector<uint32_t>().swap(vertexFaces_[c.v]);
+    prune(c.u);
+    neighbours(c.u, nu_);
+    for (uint32_t w : nu_) heap_.push(queued(c.u, w));
+}
+
+Mesh Simplifier::run(size_t targetTriangles, float maxError, float *error) {
+    double limit = double(maxError) * maxError, worst = 0;
+    while (live_ > targetTriangles && !heap_.empty()) {
+        QueuedEdge e = heap_.top();
+        heap_.pop();
+        if (removed_[e.u] || removed_[e.v] || stamp_[e.u] != e.stampU || stamp_[e.v] != e.stampV) continue;
+        Candidate c = candidate(e.u, e.v);
+        if (maxError > 0 && c.cost > limit) break;
+        if (!canCollapse(c)) continue;
+        collapse(c);
+        worst = std::max(worst, c.cost);
+    }
+    if (error) *error = float(std::sqrt(worst));
+
+    // Surviving faces in their original order, vertices in first-use order.
+    Mesh out;
+    std::vector<uint32_t> remap(pos_.size(), UINT32_MAX);
+    out.indices.reserve(live_ * 3);
+    for (size_t f = 0; f < faces_.size(); ++f) {
+        if (faceRemoved_[f]) continue;
+        for (uint32_t x : faces_[f]) {
+            if (remap[x] == UINT32_MAX) {
+                remap[x] = uint32_t(out.vertices.size());
+                out.vertices.push_back({{float(pos_[x].x), float(pos_[x].y), float(pos_[x].z)}});
+            }
+            out.indices.push_back(remap[x]);
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+Mesh simplifyMesh(const Mesh &mesh, size_t targetTriangles, float maxError, float *error) {
+    Simplifier s(mesh);
+    return s.run(targetTriangles, maxError, error);
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstddef>
+#include "primitives.h"  // for Mesh
+
+/// Simplifies an indexed mesh by quadric edge collapse (Garland & Heckbert)
+/// down to targetTriangles. Each vertex accumulates the planes of its
+/// original triangles; an edge collapses to the point closest to the planes
+/// of both ends, cheapest edge first, off a heap (O(n log n)).
+/// Boundary edges carry heavy planes perpendicular to them, so open borders
+/// stay put. Collapses that would fold a triangle over or make the mesh
+/// non-manifold are skipped.
+/// With maxError > 0 it also stops before the first collapse that would
+/// move the surface further than maxError from the planes it stood for.
+/// error, if given, receives the largest such distance of the collapses done.
+Mesh simplifyMesh(const Mesh &mesh, size_t targetTriangles, float maxError = 0, float *error = nullptr);